@@ -0,0 +1,151 @@
+#include "BatchRunner.h"
+#include "PGMimageProcessor.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Shell-style match of name against a pattern containing * and ? wildcards
+bool wildcardMatch(const std::string& pattern, const std::string& name) {
+    size_t p = 0, n = 0, starP = std::string::npos, starN = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            starP = p++;
+            starN = n;
+        } else if (starP != std::string::npos) {
+            p = starP + 1;
+            n = ++starN;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+// True for the extensions of the formats in the registry (ImageFormat.h)
+bool hasImageExtension(const fs::path& path) {
+    const fs::path extension = path.extension();
+    return extension == ".pgm" || extension == ".ppm" || extension == ".pnm";
+}
+
+// Labels one image and fills in its result
+void processImage(const std::string& input, const BatchOptions& options, BatchResult& result) {
+    result.input = input;
+    try {
+        PGMimageProcessor processor(input);
+        result.count = processor.extractComponents(options.threshold, options.minValidSize,
+                                                   options.extraction);
+        if (options.filterMin != -1 && options.filterMax != -1) {
+            result.count = processor.filterComponentsBySize(options.filterMin, options.filterMax);
+        }
+        result.largest = processor.getLargestSize();
+        result.smallest = processor.getSmallestSize();
+        if (!options.outputDir.empty()) {
+            fs::path outFile = fs::path(options.outputDir) / (fs::path(input).stem().string() + "_components.pgm");
+            if (!processor.writeComponents(outFile.string())) {
+                throw std::runtime_error("Failed to write " + outFile.string());
+            }
+        }
+        result.ok = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+}
+
+}
+
+// Expands a directory, wildcard pattern, manifest or single file into input paths.
+std::vector<std::string> collectBatchInputs(const std::string& spec) {
+    std::vector<std::string> inputs;
+    std::error_code ec;
+    fs::path path(spec);
+    std::string name = path.filename().string();
+
+    if (fs::is_directory(path, ec)) {
+        for (const auto& entry : fs::directory_iterator(path, ec)) {
+            if (entry.is_regular_file() && hasImageExtension(entry.path())) {
+                inputs.push_back(entry.path().string());
+            }
+        }
+    } else if (name.find_first_of("*?") != std::string::npos) {
+        fs::path dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+        for (const auto& entry : fs::directory_iterator(dir, ec)) {
+            if (entry.is_regular_file() && wildcardMatch(name, entry.path().filename().string())) {
+                inputs.push_back(entry.path().string());
+            }
+        }
+    } else if (!hasImageExtension(path) && fs::is_regular_file(path, ec)) {
+        std::ifstream manifest(spec);
+        std::string line;
+        while (std::getline(manifest, line)) {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty() && line[0] != '#') inputs.push_back(line);
+        }
+        return inputs; // manifest order is kept
+    } else {
+        inputs.push_back(spec);
+    }
+    std::sort(inputs.begin(), inputs.end());
+    return inputs;
+}
+
+// Runs the batch on a shared pool. The submitting thread reserves an estimate of each
+// image's footprint (raster plus working buffers) before queueing it, which bounds the
+// image data held by in-flight tasks to the memory budget.
+std::vector<BatchResult> runBatch(const std::vector<std::string>& inputs, const BatchOptions& options) {
+    std::vector<BatchResult> results(inputs.size());
+    ThreadPool pool(options.numThreads);
+    MemoryBudget budget(options.memoryBudget);
+
+    // Each worker already runs one image, so images are labelled single-threaded
+    BatchOptions perImage = options;
+    perImage.extraction.numThreads = 1;
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::error_code ec;
+        std::uintmax_t fileSize = fs::file_size(inputs[i], ec);
+        std::size_t footprint = ec ? 0 : static_cast<std::size_t>(fileSize) * 2;
+        budget.acquire(footprint);
+        pool.submit([&, i, footprint] {
+            processImage(inputs[i], perImage, results[i]);
+            budget.release(footprint);
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+// Writes one CSV line per image plus a totals line.
+bool writeBatchSummary(const std::string& fileName, const std::vector<BatchResult>& results) {
+    std::ofstream file;
+    if (!fileName.empty()) {
+        file.open(fileName);
+        if (!file) return false;
+    }
+    std::ostream& out = fileName.empty() ? std::cout : file;
+
+    long long totalComponents = 0;
+    int failed = 0;
+    out << "input,status,components,largest,smallest\n";
+    for (const auto& result : results) {
+        std::string status = result.ok ? "ok" : "error: " + result.error;
+        std::replace(status.begin(), status.end(), ',', ';'); // keep the CSV columns intact
+        out << result.input << ',' << status << ','
+            << result.count << ',' << result.largest << ',' << result.smallest << '\n';
+        totalComponents += result.count;
+        if (!result.ok) failed++;
+    }
+    out << "total," << (results.size() - failed) << " ok / " << failed << " failed,"
+        << totalComponents << ",,\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,50 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "ComponentLabeler.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Batch mode for findcomp: runs many images through one shared thread pool inside a
+ * single process, writing per-image outputs and one aggregated summary.
+ *
+ * */
+
+// Settings applied to every image of a batch
+struct BatchOptions {
+    int threshold = 128;
+    int minValidSize = 1;
+    int filterMin = -1;                 // size filter, disabled while either bound is -1
+    int filterMax = -1;
+    std::string outputDir;              // where <name>_components.pgm files go, empty = none
+    int numThreads = 0;                 // pool workers, 0 = hardware_concurrency
+    std::size_t memoryBudget = std::size_t(1) << 30;   // bytes of image data in flight
+    ExtractionOptions extraction;       // per-image labeling settings
+};
+
+// Outcome for one image of a batch
+struct BatchResult {
+    std::string input;
+    bool ok = false;
+    int count = 0;
+    int largest = 0;
+    int smallest = 0;
+    std::string error;
+};
+
+// Expands an input spec into a sorted list of files: a directory yields its .pgm, .ppm and
+// .pnm files, a pattern with * or ? in the file name is matched against its directory, and
+// any other existing file without one of those extensions is read as a manifest with one
+// path per line (blank lines and lines starting with # are skipped). An image file is
+// returned as is.
+std::vector<std::string> collectBatchInputs(const std::string& spec);
+
+// Processes every input on a shared pool; results are returned in input order.
+std::vector<BatchResult> runBatch(const std::vector<std::string>& inputs, const BatchOptions& options);
+
+// Writes results as CSV to fileName, or to std::cout when fileName is empty.
+bool writeBatchSummary(const std::string& fileName, const std::vector<BatchResult>& results);
+
+#endif
@@ -0,0 +1,54 @@
+#include "BitImage.h"
+#include "ThresholdKernel.h"
+
+// Creates an empty 0 x 0 image.
+BitImage::BitImage() : width(0), height(0), stride(0) {}
+
+// Creates a cleared width x height image.
+BitImage::BitImage(int width, int height)
+    : width(width), height(height), stride(((width + 63) / 64 + 3) & ~3),
+      words(static_cast<std::size_t>(stride) * height, 0) {}
+
+// Returns the image width in pixels.
+int BitImage::getWidth() const { return width; }
+
+// Returns the image height in pixels.
+int BitImage::getHeight() const { return height; }
+
+// Returns the number of 64-bit words per row.
+int BitImage::getStride() const { return stride; }
+
+// Returns a pointer to the first word of row y.
+std::uint64_t* BitImage::row(int y) { return words.data() + static_cast<std::size_t>(y) * stride; }
+
+// Returns a pointer to the first word of row y.
+const std::uint64_t* BitImage::row(int y) const {
+    return words.data() + static_cast<std::size_t>(y) * stride;
+}
+
+// Returns true if pixel (x, y) is set.
+bool BitImage::get(int x, int y) const { return (row(y)[x / 64] >> (x % 64)) & 1; }
+
+// Sets or clears pixel (x, y).
+void BitImage::set(int x, int y, bool on) {
+    std::uint64_t bit = 1ULL << (x % 64);
+    if (on) row(y)[x / 64] |= bit;
+    else row(y)[x / 64] &= ~bit;
+}
+
+// Fills the image from a width x height grayscale buffer: a pixel is set when gray >= threshold.
+void BitImage::threshold(const unsigned char* gray, unsigned char threshold) {
+    for (int y = 0; y < height; ++y) {
+        thresholdToBitMask(gray + static_cast<std::size_t>(y) * width, row(y), width, threshold);
+    }
+}
+
+// Returns the number of bytes held by the bit planes.
+std::size_t BitImage::memoryBytes() const { return words.size() * sizeof(std::uint64_t); }
+
+// Counts the set pixels with one popcount per word.
+std::size_t BitImage::countSet() const {
+    std::size_t count = 0;
+    for (std::uint64_t word : words) count += std::popcount(word);
+    return count;
+}
@@ -0,0 +1,102 @@
+#ifndef BIT_IMAGE_H
+#define BIT_IMAGE_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/*
+ * Binary image with one bit per pixel, used as the mask between thresholding and labeling.
+ * Each row is stored as 64-bit words (pixel x is bit x % 64 of word x / 64) and the row
+ * stride is padded to a multiple of four words and the storage is allocated on a 32-byte
+ * boundary, so every row starts on one.
+ * Bits past the image width are always zero.
+ *
+ * */
+
+// Allocator for the bit planes: storage aligned to Alignment bytes
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+    }
+    void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t{Alignment}); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+};
+
+class BitImage
+{
+   private:
+      int width;
+      int height;
+      int stride;                         // words per row, including padding
+      std::vector<std::uint64_t, AlignedAllocator<std::uint64_t, 32>> words;   // row-major bit planes
+
+   public:
+      BitImage();
+      BitImage(int width, int height);
+      ~BitImage() = default;
+
+    // methods
+    int getWidth() const;
+    int getHeight() const;
+    int getStride() const;                    // words per row
+    std::uint64_t* row(int y);                // first word of row y
+    const std::uint64_t* row(int y) const;
+    bool get(int x, int y) const;             // is pixel (x, y) set
+    void set(int x, int y, bool on);          // set or clear pixel (x, y)
+    void threshold(const unsigned char* gray, unsigned char threshold); // pixel = gray >= threshold
+    std::size_t memoryBytes() const;          // bytes used by the bit planes
+    std::size_t countSet() const;             // number of set pixels
+
+    // Calls fn(xStart, xEnd) for every run of set pixels on row y, left to right.
+    template <typename Fn>
+    void forEachRun(int y, Fn&& fn) const { forEachRunInRow(row(y), width, fn); }
+
+    // Calls fn(xStart, xEnd) for every run of set pixels in a row of width bits packed like a
+    // BitImage row (bits past width zero). Empty words are skipped whole and run ends are
+    // found with count-trailing-zeros.
+    template <typename Fn>
+    static void forEachRunInRow(const std::uint64_t* bits, int width, Fn&& fn) {
+        const int wordCount = (width + 63) / 64;
+        int runStart = -1;
+        for (int w = 0; w < wordCount; ++w) {
+            std::uint64_t word = bits[w];
+            const int base = w * 64;
+            if (runStart >= 0) {
+                // A run is open from the previous word: find where it stops
+                std::uint64_t gaps = ~word;
+                if (gaps == 0) continue;
+                int end = std::countr_zero(gaps);
+                fn(runStart, base + end - 1);
+                runStart = -1;
+                word &= ~0ULL << end;
+            }
+            while (word != 0) {
+                int start = std::countr_zero(word);
+                std::uint64_t gaps = ~word & (~0ULL << start);
+                if (gaps == 0) {
+                    runStart = base + start;   // run continues into the next word
+                    break;
+                }
+                int end = std::countr_zero(gaps);
+                fn(base + start, base + end - 1);
+                word &= ~0ULL << end;
+            }
+        }
+        if (runStart >= 0) fn(runStart, width - 1);
+    }
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "ColourKernel.h"
+#include "ImageFormat.h"
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COLOUR_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// One bit per (r, g): set where the single b that makes 299 r + 587 g + 114 b a multiple of
+// 1000 gets a gray value one below the exact quotient from grayFromRGB
+class CorrectionTable {
+    std::array<std::uint64_t, 1024> bits{};
+
+public:
+    CorrectionTable() {
+        for (int r = 0; r < 256; ++r) {
+            for (int g = 0; g < 256; ++g) {
+                // 114 b = -(299 r + 587 g) mod 1000 needs an even right side, and then
+                // b = (rhs / 2) * 193 mod 500, 193 being the inverse of 57 mod 500
+                const int rhs = (1000 - (299 * r + 587 * g) % 1000) % 1000;
+                if (rhs % 2 != 0) continue;
+                const int b = (rhs / 2) * 193 % 500;
+                if (b > 255) continue;
+                const int sum = 299 * r + 587 * g + 114 * b;
+                if (grayFromRGB(r, g, b) != sum / 1000) {
+                    const int index = (r << 8) | g;
+                    bits[index >> 6] |= std::uint64_t{1} << (index & 63);
+                }
+            }
+        }
+    }
+    unsigned get(unsigned char r, unsigned char g) const {
+        const int index = (r << 8) | g;
+        return static_cast<unsigned>(bits[index >> 6] >> (index & 63)) & 1;
+    }
+};
+
+const CorrectionTable& corrections() {
+    static const CorrectionTable table;
+    return table;
+}
+
+// Scalar conversion, also used for the tails of the vector variants
+void rgbToGrayScalar(const unsigned char* rgb, unsigned char* gray, std::size_t count) {
+    const CorrectionTable& table = corrections();
+    for (std::size_t i = 0; i < count; ++i) {
+        const unsigned char* px = rgb + 3 * i;
+        const int sum = 299 * px[0] + 587 * px[1] + 114 * px[2];
+        int level = sum / 1000;
+        if (level * 1000 == sum) level -= table.get(px[0], px[1]);
+        gray[i] = static_cast<unsigned char>(level);
+    }
+}
+
+#ifdef COLOUR_KERNEL_X86
+
+// The vector variants build 32-bit lanes holding (r, g) as two 16-bit words and b alone, so
+// one madd gives 299 r + 587 g and another 114 b. The quotient by 1000 is
+// ((sum >> 3) * 33555) >> 22, exact for every sum up to 255000, and lanes whose sum is an
+// exact multiple are patched from the correction table after the store.
+
+__attribute__((target("sse4.1")))
+void rgbToGraySse41(const unsigned char* rgb, unsigned char* gray, std::size_t count) {
+    const CorrectionTable& table = corrections();
+    const __m128i rgShuffle = _mm_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m128i bShuffle = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    const __m128i rgWeights = _mm_set1_epi32(299 | (587 << 16));
+    const __m128i bWeights = _mm_set1_epi32(114);
+    const __m128i reciprocal = _mm_set1_epi32(33555);
+    std::size_t i = 0;
+    for (; i + 6 <= count; i += 4) {   // the 16-byte load reads past pixel i + 3
+        const unsigned char* p = rgb + 3 * i;
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_shuffle_epi8(px, rgShuffle), rgWeights),
+                                          _mm_madd_epi16(_mm_shuffle_epi8(px, bShuffle), bWeights));
+        const __m128i level = _mm_srli_epi32(_mm_mullo_epi32(_mm_srli_epi32(sum, 3), reciprocal), 22);
+        const __m128i product = _mm_sub_epi32(_mm_slli_epi32(level, 10),
+                                              _mm_add_epi32(_mm_slli_epi32(level, 4), _mm_slli_epi32(level, 3)));
+        unsigned exact = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(sum, product))));
+        const __m128i words = _mm_packus_epi32(level, level);
+        const int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+        __builtin_memcpy(gray + i, &bytes, 4);
+        for (; exact != 0; exact &= exact - 1) {
+            const int lane = __builtin_ctz(exact);
+            gray[i + lane] -= table.get(p[3 * lane], p[3 * lane + 1]);
+        }
+    }
+    rgbToGrayScalar(rgb + 3 * i, gray + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void rgbToGrayAvx2(const unsigned char* rgb, unsigned char* gray, std::size_t count) {
+    const CorrectionTable& table = corrections();
+    const __m256i rgShuffle = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1,
+                                               0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m256i bShuffle = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+                                              2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    const __m256i rgWeights = _mm256_set1_epi32(299 | (587 << 16));
+    const __m256i bWeights = _mm256_set1_epi32(114);
+    const __m256i reciprocal = _mm256_set1_epi32(33555);
+    std::size_t i = 0;
+    for (; i + 10 <= count; i += 8) {   // pixels i..i+3 in the low lane, i+4..i+7 in the high one
+        const unsigned char* p = rgb + 3 * i;
+        const __m256i px = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+        const __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(px, rgShuffle), rgWeights),
+                                             _mm256_madd_epi16(_mm256_shuffle_epi8(px, bShuffle), bWeights));
+        const __m256i level = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(sum, 3), reciprocal), 22);
+        const __m256i product = _mm256_sub_epi32(_mm256_slli_epi32(level, 10),
+                                                 _mm256_add_epi32(_mm256_slli_epi32(level, 4), _mm256_slli_epi32(level, 3)));
+        unsigned exact = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(sum, product))));
+        const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(level), _mm256_extracti128_si256(level, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(gray + i), _mm_packus_epi16(words, words));
+        for (; exact != 0; exact &= exact - 1) {
+            const int lane = __builtin_ctz(exact);
+            gray[i + lane] -= table.get(p[3 * lane], p[3 * lane + 1]);
+        }
+    }
+    rgbToGrayScalar(rgb + 3 * i, gray + i, count - i);
+}
+
+#endif
+
+// Every variant this CPU can run, scalar first and the preferred one last
+std::vector<ColourKernelSet> supportedSets() {
+    std::vector<ColourKernelSet> sets = {{"scalar", rgbToGrayScalar}};
+#ifdef COLOUR_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) sets.push_back({"sse4.1", rgbToGraySse41});
+    if (__builtin_cpu_supports("avx2")) sets.push_back({"avx2", rgbToGrayAvx2});
+#endif
+    return sets;
+}
+
+// The kernel chosen for this CPU, resolved on first use
+const ColourKernelSet& kernels() {
+    static const ColourKernelSet selected = colourKernelSets().back();
+    return selected;
+}
+
+}
+
+// Lists the variants once, on first use.
+const std::vector<ColourKernelSet>& colourKernelSets() {
+    static const std::vector<ColourKernelSet> sets = supportedSets();
+    return sets;
+}
+
+// Colour conversion, dispatched to the best kernel for this CPU
+void rgbToGray(const unsigned char* rgb, unsigned char* gray, std::size_t count) {
+    kernels().rgbToGray(rgb, gray, count);
+}
+
+// Returns the name of the selected kernel variant
+const char* colourKernelName() { return kernels().name; }
@@ -0,0 +1,35 @@
+#ifndef COLOUR_KERNEL_H
+#define COLOUR_KERNEL_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * Colour to gray conversion for whole rows of interleaved RGB bytes.
+ * The luma is computed in integers as floor((299 r + 587 g + 114 b) / 1000). The double
+ * expression in grayFromRGB (ImageFormat.h) truncates a value just below the integer for
+ * some pixels whose sum is an exact multiple of 1000. For a given (r, g) at most one b gives
+ * such a sum, so a 64K-bit table built from grayFromRGB corrects exactly those pixels and
+ * the result is identical to grayFromRGB for all 2^24 inputs.
+ * SSE4.1 and AVX2 variants deinterleave the channels with byte shuffles; the variant is
+ * picked once at runtime, with a portable scalar fallback.
+ *
+ * */
+
+// Writes the gray value of each of count pixels (3 bytes each, r g b) to gray
+void rgbToGray(const unsigned char* rgb, unsigned char* gray, std::size_t count);
+
+// One variant of the conversion above
+struct ColourKernelSet {
+    const char* name;
+    void (*rgbToGray)(const unsigned char*, unsigned char*, std::size_t);
+};
+
+// Every variant this CPU supports, scalar first and the dispatched one last, so tests and
+// benchmarks can run each of them directly
+const std::vector<ColourKernelSet>& colourKernelSets();
+
+// Name of the kernel variant selected for this CPU ("avx2", "sse4.1" or "scalar")
+const char* colourKernelName();
+
+#endif
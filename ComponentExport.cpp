@@ -0,0 +1,258 @@
+#include "ComponentExport.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+namespace {
+
+constexpr char fileMagic[4] = {'F', 'C', 'C', 'R'};
+constexpr std::uint32_t fileVersion = 1;
+constexpr std::uint32_t byteOrderMark = 0x01020304;
+
+static_assert(sizeof(PixelRun) == 12 && alignof(PixelRun) == 4, "PixelRun is stored as three int32 fields");
+static_assert(sizeof(ComponentFileHeader) % 8 == 0, "sections after the header must stay 8-byte aligned");
+
+// Element size of every section, in file order; the writer lays the file out with it and
+// the reader checks the section bounds against it
+constexpr std::uint64_t sectionElementSizes[] = {4, 4, 8, 4, 4, 4, 4, 8, 8, 8, sizeof(PixelRun)};
+static_assert(std::size(sectionElementSizes) == static_cast<std::size_t>(ComponentSection::Count),
+              "one element size per section");
+
+// Number of elements in section s of a file with componentCount components and spanCount runs
+std::uint64_t sectionLength(int s, std::uint64_t componentCount, std::uint64_t spanCount) {
+    if (s == static_cast<int>(ComponentSection::SpanFirst)) return componentCount + 1;
+    if (s == static_cast<int>(ComponentSection::Spans)) return spanCount;
+    return componentCount;
+}
+
+// Text records are formatted into a buffer with to_chars and written in large blocks
+class TextOutput {
+    std::ostream& out;
+    std::string buffer;
+
+public:
+    explicit TextOutput(std::ostream& out) : out(out) { buffer.reserve(1 << 16); }
+    ~TextOutput() { flush(); }
+
+    TextOutput& operator<<(const char* text) { buffer += text; return *this; }
+    TextOutput& operator<<(char c) { buffer += c; return *this; }
+    template <typename T>
+    TextOutput& operator<<(T value) {
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof digits, value);   // shortest exact form for doubles
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+    void endRecord() {
+        buffer += '\n';
+        if (buffer.size() >= (1 << 16) - 256) flush();
+    }
+    void flush() {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
+
+void writeCsv(std::ostream& stream, const std::vector<ComponentPtr>& components) {
+    TextOutput out(stream);
+    out << "id,class,size,min_x,min_y,max_x,max_y,centroid_x,centroid_y";
+    out.endRecord();
+    for (const auto& component : components) {
+        const ComponentStats& stats = component->getStats();
+        out << component->getId() << ',' << component->getClassValue() << ',' << stats.area << ','
+            << stats.minX << ',' << stats.minY << ',' << stats.maxX << ',' << stats.maxY << ','
+            << stats.centroidX() << ',' << stats.centroidY();
+        out.endRecord();
+    }
+}
+
+void writeJson(std::ostream& stream, const std::vector<ComponentPtr>& components, int width, int height) {
+    TextOutput out(stream);
+    out << "{\"width\": " << width << ", \"height\": " << height << ", \"components\": [";
+    out.endRecord();
+    for (std::size_t k = 0; k < components.size(); ++k) {
+        const ComponentStats& stats = components[k]->getStats();
+        out << "  {\"id\": " << components[k]->getId() << ", \"class\": " << components[k]->getClassValue()
+            << ", \"size\": " << stats.area << ", \"box\": [" << stats.minX << ", " << stats.minY << ", "
+            << stats.maxX << ", " << stats.maxY << "], \"centroid\": [" << stats.centroidX() << ", "
+            << stats.centroidY() << "]}" << (k + 1 < components.size() ? "," : "");
+        out.endRecord();
+    }
+    out << "]}";
+    out.endRecord();
+}
+
+// Writes one section: the field of every component, padded to the next 8-byte boundary
+template <typename T, typename Field>
+void writeSection(std::ostream& out, const std::vector<ComponentPtr>& components, Field field) {
+    std::vector<T> values;
+    values.reserve(components.size() + 1);
+    for (const auto& component : components) values.push_back(static_cast<T>(field(*component)));
+    const std::size_t bytes = values.size() * sizeof(T);
+    out.write(reinterpret_cast<const char*>(values.data()), bytes);
+    const char padding[8] = {};
+    out.write(padding, (8 - bytes % 8) % 8);
+}
+
+bool writeBinary(std::ostream& out, const std::vector<ComponentPtr>& components, int width, int height) {
+    std::uint64_t spanCount = 0;
+    for (const auto& component : components) spanCount += component->getRuns().size();
+
+    ComponentFileHeader header{};
+    std::memcpy(header.magic, fileMagic, sizeof fileMagic);
+    header.version = fileVersion;
+    header.byteOrder = byteOrderMark;
+    header.width = static_cast<std::uint32_t>(width);
+    header.height = static_cast<std::uint32_t>(height);
+    header.componentCount = components.size();
+    header.spanCount = spanCount;
+
+    const std::size_t n = components.size();
+    std::uint64_t offset = sizeof header;
+    for (int s = 0; s < static_cast<int>(ComponentSection::Count); ++s) {
+        header.offsets[s] = offset;
+        offset += (sectionElementSizes[s] * sectionLength(s, n, spanCount) + 7) / 8 * 8;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+    writeSection<std::uint32_t>(out, components, [](const ConnectedComponent& c) { return c.getId(); });
+    writeSection<std::uint32_t>(out, components, [](const ConnectedComponent& c) { return c.getClassValue(); });
+    writeSection<std::uint64_t>(out, components, [](const ConnectedComponent& c) { return c.getStats().area; });
+    writeSection<std::int32_t>(out, components, [](const ConnectedComponent& c) { return c.getStats().minX; });
+    writeSection<std::int32_t>(out, components, [](const ConnectedComponent& c) { return c.getStats().minY; });
+    writeSection<std::int32_t>(out, components, [](const ConnectedComponent& c) { return c.getStats().maxX; });
+    writeSection<std::int32_t>(out, components, [](const ConnectedComponent& c) { return c.getStats().maxY; });
+    writeSection<double>(out, components, [](const ConnectedComponent& c) { return c.getStats().centroidX(); });
+    writeSection<double>(out, components, [](const ConnectedComponent& c) { return c.getStats().centroidY(); });
+
+    std::vector<std::uint64_t> spanFirst(1, 0);
+    spanFirst.reserve(n + 1);
+    for (const auto& component : components) spanFirst.push_back(spanFirst.back() + component->getRuns().size());
+    out.write(reinterpret_cast<const char*>(spanFirst.data()), spanFirst.size() * sizeof(std::uint64_t));
+
+    // Runs are gathered into blocks so small components do not cost a stream write each
+    std::vector<PixelRun> block;
+    block.reserve(1 << 14);
+    for (const auto& component : components) {
+        const auto& runs = component->getRuns();
+        if (block.size() + runs.size() > block.capacity()) {
+            out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(PixelRun));
+            block.clear();
+        }
+        if (runs.size() > block.capacity()) {
+            out.write(reinterpret_cast<const char*>(runs.data()), runs.size() * sizeof(PixelRun));
+        } else {
+            block.insert(block.end(), runs.begin(), runs.end());
+        }
+    }
+    out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(PixelRun));
+    const char padding[8] = {};
+    out.write(padding, (8 - spanCount * sizeof(PixelRun) % 8) % 8);
+    return static_cast<bool>(out);
+}
+
+}
+
+// Picks the format from the extension.
+ComponentDataFormat componentDataFormatFor(const std::string& fileName) {
+    auto endsWith = [&](const std::string& suffix) {
+        if (fileName.size() < suffix.size()) return false;
+        return std::equal(suffix.rbegin(), suffix.rend(), fileName.rbegin(),
+                          [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); });
+    };
+    if (fileName == "-" || endsWith(".csv")) return ComponentDataFormat::Csv;
+    if (endsWith(".json")) return ComponentDataFormat::Json;
+    return ComponentDataFormat::Binary;
+}
+
+// Opens the file (or stdout for "-" in the text formats) and writes the components.
+bool writeComponentData(const std::string& fileName, const std::vector<ComponentPtr>& components,
+                        int width, int height, ComponentDataFormat format) {
+    std::ofstream file;
+    const bool toStdout = fileName == "-" && format != ComponentDataFormat::Binary;
+    if (!toStdout) {
+        file.open(fileName, std::ios::binary);
+        if (!file) return false;
+    }
+    std::ostream& out = toStdout ? std::cout : file;
+
+    switch (format) {
+        case ComponentDataFormat::Csv: writeCsv(out, components); break;
+        case ComponentDataFormat::Json: writeJson(out, components, width, height); break;
+        case ComponentDataFormat::Binary: writeBinary(out, components, width, height); break;
+    }
+    return static_cast<bool>(out);
+}
+
+// Maps (or failing that, reads) fileName and checks the header and section bounds.
+ComponentResults::ComponentResults(const std::string& fileName) : data(nullptr), size(0), header(nullptr) {
+    auto file = std::make_shared<const MappedFile>(fileName);
+    if (file->isOpen()) {
+        data = file->getData();
+        size = file->getSize();
+        mapping = std::move(file);
+    } else {
+        // Read into 64-bit words so the sections keep their alignment
+        std::ifstream ifs(fileName, std::ios::binary);
+        if (!ifs) {
+            std::cerr << "Failed to open file for read: " << fileName << std::endl;
+            return;
+        }
+        const std::vector<char> bytes{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+        contents.resize((bytes.size() + 7) / 8);
+        std::memcpy(contents.data(), bytes.data(), bytes.size());
+        data = reinterpret_cast<const unsigned char*>(contents.data());
+        size = bytes.size();
+    }
+
+    const auto* candidate = reinterpret_cast<const ComponentFileHeader*>(data);
+    if (size < sizeof(ComponentFileHeader) || std::memcmp(candidate->magic, fileMagic, sizeof fileMagic) != 0 ||
+        candidate->version != fileVersion || candidate->byteOrder != byteOrderMark) {
+        std::cerr << "Not a component file of this version and byte order: " << fileName << std::endl;
+        return;
+    }
+    for (int s = 0; s < static_cast<int>(ComponentSection::Count); ++s) {
+        const std::uint64_t count = sectionLength(s, candidate->componentCount, candidate->spanCount);
+        const std::uint64_t offset = candidate->offsets[s];
+        if (offset % 8 != 0 || offset > size || count > (size - offset) / sectionElementSizes[s]) {
+            std::cerr << "Truncated or corrupt component file: " << fileName << std::endl;
+            return;
+        }
+    }
+    header = candidate;
+}
+
+// Takes over other's buffer; moving a vector keeps its storage, so data and header stay valid.
+ComponentResults::ComponentResults(ComponentResults&& other) noexcept
+    : mapping(std::move(other.mapping)), contents(std::move(other.contents)), data(other.data), size(other.size),
+      header(other.header) {
+    other.data = nullptr;
+    other.size = 0;
+    other.header = nullptr;
+}
+
+// Releases this file and takes over other's buffer.
+ComponentResults& ComponentResults::operator=(ComponentResults&& other) noexcept {
+    if (this != &other) {
+        mapping = std::move(other.mapping);
+        contents = std::move(other.contents);
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        header = std::exchange(other.header, nullptr);
+    }
+    return *this;
+}
+
+// Looks the runs up through the span index, clamped to the span section.
+std::span<const PixelRun> ComponentResults::spans(std::size_t k) const {
+    if (!header || k >= header->componentCount) return {};
+    const std::uint64_t* first = section<std::uint64_t>(ComponentSection::SpanFirst);
+    const std::uint64_t end = std::min(first[k + 1], header->spanCount);
+    const std::uint64_t begin = std::min(first[k], end);
+    return {section<PixelRun>(ComponentSection::Spans) + begin, static_cast<std::size_t>(end - begin)};
+}
@@ -0,0 +1,100 @@
+#ifndef COMPONENT_EXPORT_H
+#define COMPONENT_EXPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ConnectedComponent.h"
+#include "MappedFile.h"
+
+/*
+ * Machine-readable export of extracted components.
+ * CSV and JSON carry one record per component: id, class, size, bounding box and centroid.
+ * The binary format is meant to be memory-mapped and used in place:
+ *   - a fixed header (ComponentFileHeader) with the counts and the byte offset of each section,
+ *   - one array per field (structure of arrays), each starting on an 8-byte boundary:
+ *       ids and classes (uint32), sizes (uint64), minX/minY/maxX/maxY (int32),
+ *       centroidX/centroidY (double), spanFirst (uint64, componentCount + 1 entries),
+ *   - the spans: PixelRun records (int32 y, xStart, xEnd), those of component k being
+ *     spans[spanFirst[k]..spanFirst[k + 1]).
+ * Numbers are stored in the writer's byte order, which the header records; a reader on a
+ * machine of the other order refuses the file.
+ *
+ * */
+
+enum class ComponentDataFormat { Binary, Csv, Json };
+
+enum class ComponentSection {
+    Ids, Classes, Sizes, MinX, MinY, MaxX, MaxY, CentroidX, CentroidY, SpanFirst, Spans, Count
+};
+
+struct ComponentFileHeader
+{
+    char magic[4];                   // "FCCR"
+    std::uint32_t version;           // 1
+    std::uint32_t byteOrder;         // 0x01020304 as written by the producing machine
+    std::uint32_t width;             // image size
+    std::uint32_t height;
+    std::uint32_t reserved;
+    std::uint64_t componentCount;
+    std::uint64_t spanCount;
+    std::uint64_t offsets[static_cast<int>(ComponentSection::Count)];   // from the start of the file
+};
+
+// Format implied by a file name: Csv for ".csv" or "-" (stdout), Json for ".json", else Binary
+ComponentDataFormat componentDataFormatFor(const std::string& fileName);
+
+// Writes components in the given format ("-" writes CSV or JSON to stdout). Returns false if
+// the file cannot be written.
+bool writeComponentData(const std::string& fileName, const std::vector<ComponentPtr>& components,
+                        int width, int height, ComponentDataFormat format);
+
+// Binary component file mapped (or, failing that, read) into memory. Accessors point into
+// the file and stay valid as long as the object. Problems are reported on cerr and leave
+// the results closed, in which case the accessors return nullptr and spans() is empty.
+class ComponentResults
+{
+   private:
+      std::shared_ptr<const MappedFile> mapping;   // set when the file is mapped
+      std::vector<std::uint64_t> contents;         // file words when it could not be mapped
+      const unsigned char* data;
+      std::size_t size;
+      const ComponentFileHeader* header;           // nullptr unless the file is valid
+
+      template <typename T>
+      const T* section(ComponentSection which) const {
+          return header ? reinterpret_cast<const T*>(data + header->offsets[static_cast<int>(which)]) : nullptr;
+      }
+
+   public:
+      explicit ComponentResults(const std::string& fileName);
+
+      // data and header point into the mapping or contents, so the results cannot be copied;
+      // a move takes the buffer along and leaves the source closed
+      ComponentResults(const ComponentResults&) = delete;
+      ComponentResults& operator=(const ComponentResults&) = delete;
+      ComponentResults(ComponentResults&& other) noexcept;
+      ComponentResults& operator=(ComponentResults&& other) noexcept;
+
+    // methods
+    bool isOpen() const { return header != nullptr; }
+    std::size_t getCount() const { return header ? header->componentCount : 0; }
+    int getWidth() const { return header ? header->width : 0; }
+    int getHeight() const { return header ? header->height : 0; }
+    const std::uint32_t* ids() const { return section<std::uint32_t>(ComponentSection::Ids); }
+    const std::uint32_t* classes() const { return section<std::uint32_t>(ComponentSection::Classes); }
+    const std::uint64_t* sizes() const { return section<std::uint64_t>(ComponentSection::Sizes); }
+    const std::int32_t* minX() const { return section<std::int32_t>(ComponentSection::MinX); }
+    const std::int32_t* minY() const { return section<std::int32_t>(ComponentSection::MinY); }
+    const std::int32_t* maxX() const { return section<std::int32_t>(ComponentSection::MaxX); }
+    const std::int32_t* maxY() const { return section<std::int32_t>(ComponentSection::MaxY); }
+    const double* centroidX() const { return section<double>(ComponentSection::CentroidX); }
+    const double* centroidY() const { return section<double>(ComponentSection::CentroidY); }
+    std::span<const PixelRun> spans(std::size_t k) const;   // runs of component k
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "ComponentFilter.h"
+#include <utility>
+
+// Keeps components whose pixel count lies in [minSize, maxSize].
+ComponentFilter& ComponentFilter::size(int minSize, int maxSize) {
+    predicates.push_back([minSize, maxSize](const ConnectedComponent& component) {
+        return component.getNumPixels() >= minSize && component.getNumPixels() <= maxSize;
+    });
+    return *this;
+}
+
+// Keeps components whose bounding box is between minWidth x minHeight and maxWidth x maxHeight.
+ComponentFilter& ComponentFilter::boxSize(int minWidth, int minHeight, int maxWidth, int maxHeight) {
+    predicates.push_back([=](const ConnectedComponent& component) {
+        const ComponentStats& stats = component.getStats();
+        return stats.boxWidth() >= minWidth && stats.boxWidth() <= maxWidth &&
+               stats.boxHeight() >= minHeight && stats.boxHeight() <= maxHeight;
+    });
+    return *this;
+}
+
+// Keeps components whose bounding box lies entirely inside the region (inclusive).
+ComponentFilter& ComponentFilter::within(int minX, int minY, int maxX, int maxY) {
+    predicates.push_back([=](const ConnectedComponent& component) {
+        const ComponentStats& stats = component.getStats();
+        return stats.minX >= minX && stats.minY >= minY && stats.maxX <= maxX && stats.maxY <= maxY;
+    });
+    return *this;
+}
+
+// Keeps components of one class (see labelClasses).
+ComponentFilter& ComponentFilter::ofClass(std::uint32_t classValue) {
+    predicates.push_back([classValue](const ConnectedComponent& component) {
+        return component.getClassValue() == classValue;
+    });
+    return *this;
+}
+
+// Keeps components whose bounding box width / height lies in [minRatio, maxRatio].
+ComponentFilter& ComponentFilter::aspectRatio(double minRatio, double maxRatio) {
+    predicates.push_back([minRatio, maxRatio](const ConnectedComponent& component) {
+        const ComponentStats& stats = component.getStats();
+        if (stats.boxHeight() == 0) return false;
+        double ratio = static_cast<double>(stats.boxWidth()) / stats.boxHeight();
+        return ratio >= minRatio && ratio <= maxRatio;
+    });
+    return *this;
+}
+
+// Adds a custom test to the chain.
+ComponentFilter& ComponentFilter::where(Predicate predicate) {
+    predicates.push_back(std::move(predicate));
+    return *this;
+}
+
+// Returns true if the filter has no predicates and so keeps everything.
+bool ComponentFilter::empty() const { return predicates.empty(); }
+
+// Returns true if every predicate accepts the component.
+bool ComponentFilter::accepts(const ConnectedComponent& component) const {
+    for (const auto& predicate : predicates) {
+        if (!predicate(component)) return false;
+    }
+    return true;
+}
+
+// Returns the largest size in the index.
+int ComponentSizeIndex::largest() const { return sizes.empty() ? 0 : sizes.back(); }
+
+// Returns the smallest size in the index.
+int ComponentSizeIndex::smallest() const { return sizes.empty() ? 0 : sizes.front(); }
+
+// Counts the sizes in [minSize, maxSize] with two binary searches.
+int ComponentSizeIndex::countInRange(int minSize, int maxSize) const {
+    if (minSize > maxSize) return 0;
+    auto first = std::lower_bound(sizes.begin(), sizes.end(), minSize);
+    auto last = std::upper_bound(first, sizes.end(), maxSize);
+    return static_cast<int>(last - first);
+}
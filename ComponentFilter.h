@@ -0,0 +1,71 @@
+#ifndef COMPONENT_FILTER_H
+#define COMPONENT_FILTER_H
+
+#include "ConnectedComponent.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+/*
+ * Filtering of extracted components.
+ * A ComponentFilter is a chain of predicates (size range, bounding box, aspect ratio or
+ * any custom test) that a component must all pass. Every predicate reads the summary the
+ * component keeps up to date, so filtering never walks the pixels, and apply() compacts
+ * the component list in a single pass.
+ * ComponentSizeIndex is a sorted copy of the component sizes, built once per set of
+ * components, that answers largest/smallest/range-count queries in logarithmic time.
+ *
+ * */
+
+class ComponentFilter
+{
+   public:
+      using Predicate = std::function<bool(const ConnectedComponent&)>;
+
+   private:
+      std::vector<Predicate> predicates;   // all must accept a component for it to be kept
+
+   public:
+      ComponentFilter& size(int minSize, int maxSize);                 // pixel count within [minSize, maxSize]
+      ComponentFilter& boxSize(int minWidth, int minHeight, int maxWidth, int maxHeight); // bounding box dimensions
+      ComponentFilter& within(int minX, int minY, int maxX, int maxY); // bounding box inside the region
+      ComponentFilter& aspectRatio(double minRatio, double maxRatio);  // box width / height in [minRatio, maxRatio]
+      ComponentFilter& ofClass(std::uint32_t classValue);              // class value from multi-class labeling
+      ComponentFilter& where(Predicate predicate);                     // any other test
+
+      bool empty() const;
+      bool accepts(const ConnectedComponent& component) const;
+
+      // Removes the components that are rejected, keeping the order of the others; the list
+      // holds (smart) pointers to components. Returns the number removed.
+      template <typename Container>
+      std::size_t apply(Container& components) const {
+         if (predicates.empty()) return 0;
+         return std::erase_if(components, [this](const auto& component) { return !accepts(*component); });
+      }
+};
+
+class ComponentSizeIndex
+{
+   private:
+      std::vector<int> sizes;   // ascending
+      bool built = false;
+
+   public:
+      template <typename Container>
+      void build(const Container& components) {
+         sizes.clear();
+         sizes.reserve(components.size());
+         for (const auto& component : components) sizes.push_back(component->getNumPixels());
+         std::sort(sizes.begin(), sizes.end());
+         built = true;
+      }
+      void invalidate() { built = false; }
+      bool isBuilt() const { return built; }
+
+      int largest() const;                             // 0 when there are no components
+      int smallest() const;                            // 0 when there are no components
+      int countInRange(int minSize, int maxSize) const; // components with minSize <= size <= maxSize
+};
+
+#endif
@@ -0,0 +1,303 @@
+#include "ComponentLabeler.h"
+#include "UnionFind.h"
+#include "ThresholdKernel.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// Stripes shorter than this are not worth a thread of their own
+const int kMinStripeRows = 16;
+
+// A horizontal span of foreground pixels [xStart, xEnd] on row y
+struct LabelledRun {
+    int y;
+    int xStart;
+    int xEnd;
+    int label;
+    int edgesAbove;   // pixels of the run with a foreground pixel of its class directly above
+    std::uint32_t classValue;   // runs only join runs of the same class (always 0 for masks)
+};
+
+// The runs of a horizontal band of rows, labelled independently of the other bands
+struct Stripe {
+    int yBegin = 0;
+    int yEnd = 0;
+    std::vector<LabelledRun> runs;
+    size_t firstRowEnd = 0;     // runs[0, firstRowEnd) lie on row yBegin
+    size_t lastRowBegin = 0;    // runs[lastRowBegin, end) lie on row yEnd - 1
+    int labelCount = 0;         // labels are compacted to 0..labelCount-1
+    int labelOffset = 0;        // position of this stripe's labels in the merged table
+};
+
+// Row sources call fn(xStart, xEnd, classValue) for every run of row y, left to right.
+// The scratch words (one row of mask bits) are the caller's, one set per worker.
+
+// Row source for an already thresholded mask
+struct MaskRows {
+    const BitImage& mask;
+
+    template <typename Fn>
+    void forEachRun(int y, std::vector<std::uint64_t>&, Fn&& fn) const {
+        BitImage::forEachRunInRow(mask.row(y), mask.getWidth(), [&](int xStart, int xEnd) { fn(xStart, xEnd, 0u); });
+    }
+};
+
+// Row source that thresholds the gray image one row at a time into the caller's scratch
+// words, so the whole mask never exists and the image is read exactly once
+template <typename Sample>
+struct GrayRows {
+    const Sample* gray;
+    int width;
+    Sample threshold;
+
+    template <typename Fn>
+    void forEachRun(int y, std::vector<std::uint64_t>& scratch, Fn&& fn) const {
+        thresholdToBitMask(gray + static_cast<size_t>(y) * width, scratch.data(), width, threshold);
+        BitImage::forEachRunInRow(scratch.data(), width, [&](int xStart, int xEnd) { fn(xStart, xEnd, 0u); });
+    }
+};
+
+// Row source for multi-class labeling: a run is a span of pixels with the same class
+// value, and pixels of the ignored class (if any) form no runs
+template <typename Sample>
+struct ClassRows {
+    const Sample* pixels;
+    int channels;
+    int width;
+    std::optional<std::uint32_t> ignoredClass;
+
+    template <typename Fn>
+    void forEachRun(int y, std::vector<std::uint64_t>&, Fn&& fn) const {
+        const Sample* row = pixels + static_cast<size_t>(y) * width * channels;
+        int runStart = 0;
+        std::uint32_t runClass = pixelClass(row, channels);
+        for (int x = 1; x <= width; ++x) {
+            const std::uint32_t value = (x < width) ? pixelClass(row + x * channels, channels) : ~runClass;
+            if (value == runClass) continue;
+            if (runClass != ignoredClass) fn(runStart, x - 1, runClass);
+            runStart = x;
+            runClass = value;
+        }
+    }
+};
+
+// Pixels of run [a, b] directly below pixels of run [c, d]: the 4-adjacent pairs between them,
+// which feed the perimeter whatever the connectivity
+int verticalOverlap(int a, int b, int c, int d) { return std::max(0, std::min(b, d) - std::max(a, c) + 1); }
+
+// First pass over one stripe: collect runs row by row and merge labels of runs touching
+// the row above, then compact the stripe's labels to their roots
+template <typename Policy, typename Rows>
+void labelStripe(int width, const Rows& rows, Stripe& stripe) {
+    constexpr auto reach = rowReach<Policy>();
+    UnionFind equivalences;
+    auto& runs = stripe.runs;
+    std::vector<std::uint64_t> scratch((width + 63) / 64);
+
+    size_t prevBegin = 0, prevEnd = 0;
+    for (int y = stripe.yBegin; y < stripe.yEnd; ++y) {
+        size_t rowBegin = runs.size();
+        size_t p = prevBegin;
+        rows.forEachRun(y, scratch, [&](int xStart, int xEnd, std::uint32_t classValue) {
+            // Only runs above within the policy's reach can be neighbours
+            while (p < prevEnd && runs[p].xEnd < xStart + reach.first) ++p;
+            int label = -1;
+            int edgesAbove = 0;
+            for (size_t q = p; q < prevEnd && runs[q].xStart <= xEnd + reach.second; ++q) {
+                if (runs[q].classValue != classValue) continue;
+                if (!runsTouch<Policy>(xStart, xEnd, runs[q].xStart, runs[q].xEnd)) continue;
+                label = (label < 0) ? runs[q].label : equivalences.unite(label, runs[q].label);
+                edgesAbove += verticalOverlap(xStart, xEnd, runs[q].xStart, runs[q].xEnd);
+            }
+            if (label < 0) label = equivalences.makeSet();
+            runs.push_back({y, xStart, xEnd, label, edgesAbove, classValue});
+        });
+        if (y == stripe.yBegin) stripe.firstRowEnd = runs.size();
+        prevBegin = rowBegin;
+        prevEnd = runs.size();
+    }
+    stripe.lastRowBegin = prevBegin;
+
+    std::vector<int> compactOfRoot(equivalences.size(), -1);
+    for (auto& run : runs) {
+        int root = equivalences.find(run.label);
+        if (compactOfRoot[root] < 0) compactOfRoot[root] = stripe.labelCount++;
+        run.label = compactOfRoot[root];
+    }
+}
+
+// Joins the labels of overlapping runs on either side of the seam between two stripes and
+// counts the adjacencies across it; only the lower stripe's first row is written
+template <typename Policy>
+void mergeSeam(const Stripe& upper, Stripe& lower, ConcurrentUnionFind& merged) {
+    constexpr auto reach = rowReach<Policy>();
+    size_t p = upper.lastRowBegin;
+    const size_t pEnd = upper.runs.size();
+    for (size_t i = 0; i < lower.firstRowEnd; ++i) {
+        LabelledRun& run = lower.runs[i];
+        while (p < pEnd && upper.runs[p].xEnd < run.xStart + reach.first) ++p;
+        for (size_t q = p; q < pEnd && upper.runs[q].xStart <= run.xEnd + reach.second; ++q) {
+            const LabelledRun& above = upper.runs[q];
+            if (above.classValue != run.classValue) continue;
+            if (!runsTouch<Policy>(run.xStart, run.xEnd, above.xStart, above.xEnd)) continue;
+            merged.unite(upper.labelOffset + above.label, lower.labelOffset + run.label);
+            run.edgesAbove += verticalOverlap(run.xStart, run.xEnd, above.xStart, above.xEnd);
+        }
+    }
+}
+
+// Two-pass run-based labeling of the rows produced by rows(y, scratch)
+template <typename Policy, typename Rows>
+std::vector<ComponentPtr> labelRows(int width, int height, const Rows& rows, int minValidSize,
+                                    bool countDiscardedIds, int numThreads, ProcessingStats* stats,
+                                    std::pmr::memory_resource* arena) {
+    if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+    int stripeCount = std::clamp(height / kMinStripeRows, 1, numThreads);
+
+    // Split the image into horizontal stripes and label them on the shared pool's workers
+    std::vector<Stripe> stripes(stripeCount);
+    for (int s = 0; s < stripeCount; ++s) {
+        stripes[s].yBegin = static_cast<int>(static_cast<long long>(height) * s / stripeCount);
+        stripes[s].yEnd = static_cast<int>(static_cast<long long>(height) * (s + 1) / stripeCount);
+    }
+    parallelFor(sharedThreadPool(), stripeCount, numThreads, [&](int s) { labelStripe<Policy>(width, rows, stripes[s]); });
+
+    int labelCount = 0;
+    for (auto& stripe : stripes) {
+        stripe.labelOffset = labelCount;
+        labelCount += stripe.labelCount;
+    }
+
+#ifdef FINDCOMP_STATS
+    for (const auto& stripe : stripes) STATS_ADD(stats, Counter::Runs, static_cast<long long>(stripe.runs.size()));
+#endif
+
+    // Stitch the stripes together: every seam only touches its two neighbouring stripes
+    ConcurrentUnionFind merged(labelCount);
+    parallelFor(sharedThreadPool(), stripeCount - 1, numThreads, [&](int s) { mergeSeam<Policy>(stripes[s], stripes[s + 1], merged); });
+
+    // Second pass: number the final components in order of their first run, size them
+    // and count their runs so each component's storage is allocated exactly once
+    std::vector<int> componentOfRoot(labelCount, -1);
+    std::vector<int> sizes;
+    std::vector<int> runCounts;
+    std::vector<std::uint32_t> classes;
+    for (auto& stripe : stripes) {
+        for (auto& run : stripe.runs) {
+            int root = merged.find(stripe.labelOffset + run.label);
+            if (componentOfRoot[root] < 0) {
+                componentOfRoot[root] = static_cast<int>(sizes.size());
+                sizes.push_back(0);
+                runCounts.push_back(0);
+                classes.push_back(run.classValue);
+            }
+            run.label = componentOfRoot[root];
+            sizes[run.label] += run.xEnd - run.xStart + 1;
+            runCounts[run.label]++;
+        }
+    }
+
+    // Only allocate the components that survive the minimum size test
+    std::vector<ConnectedComponent*> byIndex(sizes.size(), nullptr);
+    std::vector<ComponentPtr> components;
+    int componentId = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        if (sizes[i] >= minValidSize) {
+            int id = countDiscardedIds ? static_cast<int>(i) : componentId++;
+            components.push_back(makeComponent(arena, id));
+            components.back()->reserveRuns(runCounts[i]);
+            components.back()->setClassValue(classes[i]);
+            byIndex[i] = components.back().get();
+        }
+    }
+
+    STATS_ADD(stats, Counter::Components, static_cast<long long>(sizes.size()));
+    STATS_ADD(stats, Counter::Allocations, static_cast<long long>(components.size()));
+
+    for (const auto& stripe : stripes) {
+        for (const auto& run : stripe.runs) {
+            ConnectedComponent* component = byIndex[run.label];
+            if (component != nullptr) {
+                component->addRun(run.y, run.xStart, run.xEnd);
+                component->addInternalEdges(run.edgesAbove);
+            }
+        }
+    }
+    return components;
+}
+
+}
+
+// Two-pass run-based labeling of a mask, see ComponentLabeler.h
+template <typename Policy>
+std::vector<ComponentPtr> labelTwoPass(const BitImage& mask,
+                                       int minValidSize,
+                                       bool countDiscardedIds,
+                                       int numThreads,
+                                       ProcessingStats* stats,
+                                       std::pmr::memory_resource* arena) {
+    return labelRows<Policy>(mask.getWidth(), mask.getHeight(), MaskRows{mask}, minValidSize, countDiscardedIds,
+                             numThreads, stats, arena);
+}
+
+// Fused threshold and two-pass labeling of a gray image, see ComponentLabeler.h
+template <typename Policy, typename Sample>
+std::vector<ComponentPtr> labelTwoPass(const Sample* gray, int width, int height,
+                                       std::type_identity_t<Sample> threshold,
+                                       int minValidSize,
+                                       bool countDiscardedIds,
+                                       int numThreads,
+                                       ProcessingStats* stats,
+                                       std::pmr::memory_resource* arena) {
+    STATS_ADD(stats, Counter::Pixels, static_cast<long long>(width) * height);
+    return labelRows<Policy>(width, height, GrayRows<Sample>{gray, width, threshold}, minValidSize, countDiscardedIds,
+                             numThreads, stats, arena);
+}
+
+// Single-pass multi-class labeling, see ComponentLabeler.h
+template <typename Policy, typename Sample>
+std::vector<ComponentPtr> labelClasses(const Sample* pixels, int channels, int width, int height,
+                                       std::optional<std::uint32_t> ignoredClass,
+                                       int minValidSize,
+                                       bool countDiscardedIds,
+                                       int numThreads,
+                                       ProcessingStats* stats,
+                                       std::pmr::memory_resource* arena) {
+    STATS_ADD(stats, Counter::Pixels, static_cast<long long>(width) * height);
+    return labelRows<Policy>(width, height, ClassRows<Sample>{pixels, channels, width, ignoredClass}, minValidSize,
+                             countDiscardedIds, numThreads, stats, arena);
+}
+
+// The neighbourhoods and gray sample types available to callers; add a line here for another
+// policy, or to INSTANTIATE_LABEL_TWO_PASS for another sample type
+#define INSTANTIATE_LABEL_TWO_PASS_GRAY(Policy, Sample)                                           \
+    template std::vector<ComponentPtr> labelTwoPass<Policy, Sample>(const Sample*, int, int, Sample, \
+                                                                    int, bool, int, ProcessingStats*, \
+                                                                    std::pmr::memory_resource*);  \
+    template std::vector<ComponentPtr> labelClasses<Policy, Sample>(const Sample*, int, int, int,   \
+                                                                    std::optional<std::uint32_t>, int, \
+                                                                    bool, int, ProcessingStats*,   \
+                                                                    std::pmr::memory_resource*);
+
+#define INSTANTIATE_LABEL_TWO_PASS(Policy)                                                        \
+    template std::vector<ComponentPtr> labelTwoPass<Policy>(const BitImage&, int, bool, int,       \
+                                                            ProcessingStats*, std::pmr::memory_resource*); \
+    INSTANTIATE_LABEL_TWO_PASS_GRAY(Policy, unsigned char)                                        \
+    INSTANTIATE_LABEL_TWO_PASS_GRAY(Policy, std::uint16_t)                                        \
+    INSTANTIATE_LABEL_TWO_PASS_GRAY(Policy, float)
+
+INSTANTIATE_LABEL_TWO_PASS(FourConnectivity)
+INSTANTIATE_LABEL_TWO_PASS(EightConnectivity)
+
+// Every valid MaskConnectivity: the row neighbours (0x28) plus any of the symmetric pairs
+// vertical (0x82), backslash (0x101) and slash (0x44)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x028>)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x0AA>)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x129>)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x06C>)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x1AB>)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x0EE>)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x16D>)
+INSTANTIATE_LABEL_TWO_PASS(MaskConnectivity<0x1EF>)
@@ -0,0 +1,99 @@
+#ifndef COMPONENT_LABELER_H
+#define COMPONENT_LABELER_H
+
+#include "ConnectedComponent.h"
+#include "BitImage.h"
+#include "Instrumentation.h"
+#include "Connectivity.h"
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Connected component labeling engines shared by PGMimageProcessor and ImageProcessor.
+ * BFS flood fill is kept inside the processors as the reference implementation; the
+ * two-pass labeler below scans a bit-packed mask strictly in raster order.
+ *
+ * */
+
+// BFS: reference flood fill. TwoPass: run-based union-find labeling (default).
+// MaxTree: components read from a component tree of the image that the processor builds
+// once and keeps, so later extractions at other thresholds skip labeling entirely.
+enum class LabelingMethod { BFS, TwoPass, MaxTree };
+
+// Options accepted by the extractComponents family
+struct ExtractionOptions {
+    LabelingMethod method = LabelingMethod::TwoPass;
+    int numThreads = 0;     // worker threads for the two-pass engine, 0 = hardware_concurrency
+    Connectivity connectivity = Connectivity::Four;   // which pixels count as neighbours
+};
+
+// Labels the set pixels of a bit-packed mask with the classic two-pass algorithm: the
+// first pass collects horizontal runs and records equivalences between runs of
+// neighbouring rows in a union-find table, the second pass resolves each run to its
+// final component. Components are returned in raster order of their first
+// pixel, which is the same order (and the same ids) the BFS seed loop produces.
+// Components smaller than minValidSize are dropped; when countDiscardedIds is set they
+// still consume an id, matching ImageProcessor's numbering.
+// With numThreads > 1 the image is cut into horizontal stripes that are labelled in
+// parallel and stitched along their seams; the result is identical to the serial run.
+// Work counters are added to stats when it is given and instrumentation is compiled in.
+// The kept components and their runs are allocated from arena.
+// Policy selects the neighbourhood (see Connectivity.h); it is instantiated for
+// FourConnectivity, EightConnectivity and every valid MaskConnectivity in ComponentLabeler.cpp.
+template <typename Policy = FourConnectivity>
+std::vector<ComponentPtr> labelTwoPass(const BitImage& mask,
+                                       int minValidSize,
+                                       bool countDiscardedIds = false,
+                                       int numThreads = 1,
+                                       ProcessingStats* stats = nullptr,
+                                       std::pmr::memory_resource* arena = std::pmr::get_default_resource());
+
+// Same as above but thresholds the gray image (pixel >= threshold) row by row while it
+// labels, instead of taking a finished mask: each worker keeps one row of mask bits, so the
+// image is read once and no width x height mask is written or read back.
+// Sample is unsigned char, std::uint16_t or float, and the threshold has the same type, so
+// deeper images are labelled at full precision without converting them first.
+template <typename Policy = FourConnectivity, typename Sample>
+std::vector<ComponentPtr> labelTwoPass(const Sample* gray, int width, int height,
+                                       std::type_identity_t<Sample> threshold,
+                                       int minValidSize,
+                                       bool countDiscardedIds = false,
+                                       int numThreads = 1,
+                                       ProcessingStats* stats = nullptr,
+                                       std::pmr::memory_resource* arena = std::pmr::get_default_resource());
+
+// Multi-class labeling in one raster pass: pixels are connected only when they have the same
+// class value, so every colour (or palette index) of the image is labelled at once instead
+// of thresholding the image once per class. The class value of a pixel is pixelClass() of
+// its channels, and each component is tagged with it (ConnectedComponent::getClassValue).
+// Pixels whose class is ignoredClass, typically the background, belong to no component.
+// Runs of equal class go through the same union-find, stripe and numbering steps as
+// labelTwoPass, so ids, ordering, statistics and threading behave identically.
+// Sample is unsigned char (channels 1 or 3), std::uint16_t or float (channels 1).
+template <typename Policy = FourConnectivity, typename Sample>
+std::vector<ComponentPtr> labelClasses(const Sample* pixels, int channels, int width, int height,
+                                       std::optional<std::uint32_t> ignoredClass,
+                                       int minValidSize,
+                                       bool countDiscardedIds = false,
+                                       int numThreads = 1,
+                                       ProcessingStats* stats = nullptr,
+                                       std::pmr::memory_resource* arena = std::pmr::get_default_resource());
+
+// Class value of the pixel at px: the sample itself for one channel (the bit pattern for
+// float samples) and 0xRRGGBB for three 8-bit channels
+template <typename Sample>
+inline std::uint32_t pixelClass(const Sample* px, int channels) {
+    if constexpr (std::is_same<Sample, float>::value) {
+        return std::bit_cast<std::uint32_t>(px[0]);
+    } else if constexpr (std::is_same<Sample, unsigned char>::value) {
+        return channels == 3 ? (std::uint32_t{px[0]} << 16) | (std::uint32_t{px[1]} << 8) | px[2] : px[0];
+    } else {
+        return px[0];
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "ComponentStats.h"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace {
+
+// Sum of k*k for k in 0..n
+double sumSquaresTo(double n) { return n * (n + 1) * (2 * n + 1) / 6; }
+
+}
+
+// Adds the run xStart..xEnd on row y to the summary, including the length - 1 horizontal
+// adjacencies inside the run.
+void ComponentStats::addRun(int y, int xStart, int xEnd) {
+    long long length = xEnd - xStart + 1;
+    if (area == 0) {
+        minX = xStart; maxX = xEnd;
+        minY = y; maxY = y;
+    } else {
+        minX = std::min(minX, xStart); maxX = std::max(maxX, xEnd);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+    }
+    area += length;
+    long long runSumX = length * (xStart + xEnd) / 2;   // arithmetic series, length * (xStart + xEnd) is even
+    sumX += runSumX;
+    sumY += length * y;
+    sumXX += sumSquaresTo(xEnd) - sumSquaresTo(xStart - 1.0);
+    sumYY += static_cast<double>(length) * y * y;
+    sumXY += static_cast<double>(runSumX) * y;
+    internalEdges += length - 1;
+}
+
+// Adds adjacencies between pixels of different rows, reported by the labeler.
+void ComponentStats::addInternalEdges(long long count) { internalEdges += count; }
+
+// Merges the summary of another part of the same component into this one.
+void ComponentStats::merge(const ComponentStats& other) {
+    if (other.area == 0) return;
+    if (area == 0) {
+        *this = other;
+        return;
+    }
+    minX = std::min(minX, other.minX); maxX = std::max(maxX, other.maxX);
+    minY = std::min(minY, other.minY); maxY = std::max(maxY, other.maxY);
+    area += other.area;
+    sumX += other.sumX;
+    sumY += other.sumY;
+    sumXX += other.sumXX;
+    sumYY += other.sumYY;
+    sumXY += other.sumXY;
+    internalEdges += other.internalEdges;
+}
+
+// Returns the width of the bounding box.
+int ComponentStats::boxWidth() const { return area ? maxX - minX + 1 : 0; }
+
+// Returns the height of the bounding box.
+int ComponentStats::boxHeight() const { return area ? maxY - minY + 1 : 0; }
+
+// Returns the mean x coordinate of the component's pixels.
+double ComponentStats::centroidX() const { return area ? static_cast<double>(sumX) / area : 0.0; }
+
+// Returns the mean y coordinate of the component's pixels.
+double ComponentStats::centroidY() const { return area ? static_cast<double>(sumY) / area : 0.0; }
+
+// Every pixel has four edges; each internal adjacency hides two of them.
+long long ComponentStats::perimeter() const { return 4 * area - 2 * internalEdges; }
+
+// Major axis angle from the central second moments.
+double ComponentStats::orientation() const {
+    if (area == 0) return 0.0;
+    double cx = centroidX(), cy = centroidY();
+    double mu20 = sumXX / area - cx * cx;
+    double mu02 = sumYY / area - cy * cy;
+    double mu11 = sumXY / area - cx * cy;
+    return 0.5 * std::atan2(2 * mu11, mu20 - mu02);
+}
+
+// Isoperimetric ratio: close to pi/4 for a square, smaller for thin or ragged shapes.
+double ComponentStats::compactness() const {
+    long long p = perimeter();
+    return p ? 4 * std::numbers::pi * area / (static_cast<double>(p) * p) : 0.0;
+}
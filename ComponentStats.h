@@ -0,0 +1,39 @@
+#ifndef COMPONENT_STATS_H
+#define COMPONENT_STATS_H
+
+/*
+ * Running summary of a connected component: area, bounding box, first and second order
+ * moments and the number of 4-adjacent pixel pairs inside it. Runs are added as they are
+ * labelled and summaries of components that turn out to be connected can be merged, so
+ * every derived feature below is an O(1) query and no pixel list is needed.
+ *
+ * */
+
+struct ComponentStats
+{
+   long long area = 0;   // number of pixels
+   int minX = 0;         // bounding box, inclusive; only meaningful once area > 0
+   int minY = 0;
+   int maxX = -1;
+   int maxY = -1;
+   long long sumX = 0;   // sum of the x coordinates of all pixels
+   long long sumY = 0;   // sum of the y coordinates of all pixels
+   double sumXX = 0.0;   // second order sums, kept in floating point to avoid overflow
+   double sumYY = 0.0;
+   double sumXY = 0.0;
+   long long internalEdges = 0;   // 4-adjacent pixel pairs that both belong to the component
+
+   // methods
+   void addRun(int y, int xStart, int xEnd);   // account for pixels xStart..xEnd of row y (and their row adjacencies)
+   void addInternalEdges(long long count);    // adjacencies found by the labeler between rows
+   void merge(const ComponentStats& other);   // absorb the summary of a connected component
+   int boxWidth() const;
+   int boxHeight() const;
+   double centroidX() const;
+   double centroidY() const;
+   long long perimeter() const;     // pixel edges between the component and the outside
+   double orientation() const;      // angle of the major axis in radians, in (-pi/2, pi/2]
+   double compactness() const;      // 4 pi area / perimeter^2 on the pixel-edge perimeter
+};
+
+#endif
@@ -1,48 +1,129 @@
 #include "ConnectedComponent.h"
 
 // Constructor that initializes a connected component with a given id and zero pixels.
-ConnectedComponent::ConnectedComponent(int id) : id(id), numPixels(0) {}
+// The runs are allocated from resource.
+ConnectedComponent::ConnectedComponent(int id, std::pmr::memory_resource* resource)
+    : id(id), numPixels(0), classValue(0), runs(resource) {}
+
+// Copies another component, allocating the runs from resource instead of the other's resource.
+ConnectedComponent::ConnectedComponent(const ConnectedComponent& other, std::pmr::memory_resource* resource)
+    : id(other.id), numPixels(other.numPixels), classValue(other.classValue), runs(other.runs, resource),
+      stats(other.stats) {}
 
 // Copy constructor: creates a new ConnectedComponent as a deep copy of another.
 ConnectedComponent::ConnectedComponent(const ConnectedComponent& other)
-    : id(other.id), numPixels(other.numPixels), pixels(other.pixels) {}
+    : id(other.id), numPixels(other.numPixels), classValue(other.classValue), runs(other.runs),
+      stats(other.stats) {}
 
 // Copy assignment operator: assigns the contents of another ConnectedComponent to this one.
 ConnectedComponent& ConnectedComponent::operator=(const ConnectedComponent& other) {
     if (this != &other) { // Avoid asigning to itself
         id = other.id;
        numPixels = other.numPixels;
-        pixels = other.pixels; // Deep copy of pixel data
+        classValue = other.classValue;
+        runs = other.runs; // Deep copy of pixel data
+        stats = other.stats;
+        pixelCache.clear();
     }
     return *this;
 }
 
 // Move constructor: transfers ownership of resources from a temporary object (rvalue) to this object.
 ConnectedComponent::ConnectedComponent(ConnectedComponent&& other) noexcept
-    : id(other.id), numPixels(other.numPixels), pixels(std::move(other.pixels)) {}
+    : id(other.id), numPixels(other.numPixels), classValue(other.classValue), runs(std::move(other.runs)),
+      stats(other.stats), pixelCache(std::move(other.pixelCache)) {}
 
 // Move assignment operator: transfers ownership of resources from a temporary object (rvalue).
 ConnectedComponent& ConnectedComponent::operator=(ConnectedComponent&& other) noexcept {
     if (this != &other) { // Avoid assigning to itself
         id = other.id;
         numPixels = other.numPixels;
-        pixels = std::move(other.pixels); 
+        classValue = other.classValue;
+        runs = std::move(other.runs); 
+        stats = other.stats;
+        pixelCache = std::move(other.pixelCache);
     }
     return *this;
 }
 
 // Adds a new pixel coordinate (x, y) to the connected component and increments the pixel count.
+// A pixel directly right of the last run extends that run instead of starting a new one.
+// Adjacencies of a single pixel are not known here; the caller reports them with addInternalEdges.
 void ConnectedComponent::addPixel(int x, int y) {
-    pixels.emplace_back(x, y);
+    if (!runs.empty() && runs.back().y == y && runs.back().xEnd + 1 == x) {
+        runs.back().xEnd = x;
+    } else {
+        runs.push_back({y, x, x});
+    }
     numPixels++;
+    stats.addRun(y, x, x);
+    pixelCache.clear();
 }
 
+// Adds the run of pixels xStart..xEnd on row y and updates the pixel count.
+void ConnectedComponent::addRun(int y, int xStart, int xEnd) {
+    runs.push_back({y, xStart, xEnd});
+    numPixels += xEnd - xStart + 1;
+    stats.addRun(y, xStart, xEnd);
+    pixelCache.clear();
+}
+
+// Adds count 4-adjacent pixel pairs that the runs alone do not reveal, used for the perimeter.
+void ConnectedComponent::addInternalEdges(long long count) { stats.addInternalEdges(count); }
+
+// Reserves storage for count runs so that filling the component does not reallocate.
+void ConnectedComponent::reserveRuns(std::size_t count) { runs.reserve(count); }
+
 // Returns the unique identifier of the connected component.
 int ConnectedComponent::getId() const { return id; }
 
+// Returns the class value shared by the pixels (0 for binary images).
+std::uint32_t ConnectedComponent::getClassValue() const { return classValue; }
+
+// Tags the component with the class value its pixels share.
+void ConnectedComponent::setClassValue(std::uint32_t value) { classValue = value; }
+
 // Returns the number of pixels that belong to this component.
 int ConnectedComponent::getNumPixels() const { return numPixels; }
 
-// Returns a reference to the vector containing all pixel coordinates in this component.
-const std::vector<std::pair<int, int>>& ConnectedComponent::getPixels() const { return pixels; }
+// Returns the runs that make up this component, in the order they were added.
+const std::pmr::vector<PixelRun>& ConnectedComponent::getRuns() const { return runs; }
+
+// Returns the running summary of the component; every query on it is O(1).
+const ComponentStats& ConnectedComponent::getStats() const { return stats; }
+
+// Returns a range that yields every (x, y) pixel of the component in insertion order.
+PixelRange ConnectedComponent::pixels() const {
+    return PixelRange(runs.data(), runs.data() + runs.size());
+}
+
+// Returns a reference to a vector containing all pixel coordinates in this component.
+// The vector is expanded from the runs on first use; prefer getRuns() or pixels().
+const std::vector<std::pair<int, int>>& ConnectedComponent::getPixels() const {
+    if (pixelCache.size() != static_cast<std::size_t>(numPixels)) {
+        pixelCache.assign(pixels().begin(), pixels().end());
+    }
+    return pixelCache;
+}
+
+// Destroys the component and gives its memory back to the resource it was allocated from.
+void ComponentDeleter::operator()(ConnectedComponent* component) const {
+    if (resource == nullptr) {
+        delete component;
+        return;
+    }
+    component->~ConnectedComponent();
+    resource->deallocate(component, sizeof(ConnectedComponent), alignof(ConnectedComponent));
+}
 
+// Creates an empty component whose object and runs both live in resource.
+ComponentPtr makeComponent(std::pmr::memory_resource* resource, int id) {
+    void* memory = resource->allocate(sizeof(ConnectedComponent), alignof(ConnectedComponent));
+    return ComponentPtr(new (memory) ConnectedComponent(id, resource), ComponentDeleter{resource});
+}
+
+// Creates a deep copy of other whose object and runs both live in resource.
+ComponentPtr cloneComponent(std::pmr::memory_resource* resource, const ConnectedComponent& other) {
+    void* memory = resource->allocate(sizeof(ConnectedComponent), alignof(ConnectedComponent));
+    return ComponentPtr(new (memory) ConnectedComponent(other, resource), ComponentDeleter{resource});
+}
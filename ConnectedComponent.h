@@ -3,22 +3,93 @@
 
 #include <vector>
 #include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include "ComponentStats.h"
 
 /*
  *The class is a connected component in a binary image
  * It stores the pixel Coordinates, size and id
+ * Pixels are kept as horizontal runs (row, xStart, xEnd), so a solid blob costs
+ * one entry per row instead of one per pixel.
+ * Bounding box, moments and adjacency counts are accumulated as pixels are added, so
+ * shape features can be read without walking the pixels again.
+ * Components found by multi-class labeling also carry the class value (colour or palette
+ * index) their pixels share; it is 0 for components of a binary image.
+ * Components and their runs can be placed in a memory resource (an arena owned by the
+ * processor) so that a whole extraction is freed at once; ComponentPtr owns such objects.
  *
  * */
 
+// A horizontal span of pixels xStart..xEnd (inclusive) on row y
+struct PixelRun {
+   int y;
+   int xStart;
+   int xEnd;
+
+   int length() const { return xEnd - xStart + 1; }
+};
+
+// Forward iterator that expands a sequence of runs into (x, y) pixel coordinates
+class PixelIterator {
+   private:
+      const PixelRun* run;
+      const PixelRun* end;
+      int x;
+
+   public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = std::pair<int, int>;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = value_type;
+
+      PixelIterator() : run(nullptr), end(nullptr), x(0) {}
+      PixelIterator(const PixelRun* run, const PixelRun* end)
+         : run(run), end(end), x(run != end ? run->xStart : 0) {}
+
+      value_type operator*() const { return {x, run->y}; }
+      PixelIterator& operator++() {
+         if (++x > run->xEnd) {
+            ++run;
+            x = (run != end) ? run->xStart : 0;
+         }
+         return *this;
+      }
+      PixelIterator operator++(int) { PixelIterator old = *this; ++*this; return old; }
+      bool operator==(const PixelIterator& other) const { return run == other.run && x == other.x; }
+      bool operator!=(const PixelIterator& other) const { return !(*this == other); }
+};
+
+// Range adaptor so components can be walked pixel by pixel without materialising them
+class PixelRange {
+   private:
+      const PixelRun* first;
+      const PixelRun* last;
+
+   public:
+      PixelRange(const PixelRun* first, const PixelRun* last) : first(first), last(last) {}
+      PixelIterator begin() const { return PixelIterator(first, last); }
+      PixelIterator end() const { return PixelIterator(last, last); }
+};
+
 class ConnectedComponent
 {
    private:
       int id;     // id for the component
       int numPixels;  // number of pixels in the component
-      std::vector<std::pair<int, int>> pixels;    // coordinates of the pixels in the component
+      std::uint32_t classValue;  // class shared by the pixels, see ComponentLabeler.h
+      std::pmr::vector<PixelRun> runs;  // pixels of the component as horizontal runs
+      ComponentStats stats;          // bounding box, moments and adjacencies of the runs
+      mutable std::vector<std::pair<int, int>> pixelCache;   // expanded pixels, built on demand by getPixels()
 						 
    public:
-      explicit ConnectedComponent(int id);
+      explicit ConnectedComponent(int id,
+                                  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+      ConnectedComponent(const ConnectedComponent& other, std::pmr::memory_resource* resource); // copy into resource
       ~ConnectedComponent() = default;
 	
   
@@ -29,11 +100,32 @@ class ConnectedComponent
 
     // methods
     void addPixel(int x, int y); // add a pixel to the component
+    void addRun(int y, int xStart, int xEnd); // add the pixels xStart..xEnd of row y
+    void addInternalEdges(long long count);   // record adjacencies between rows found by the labeler
+    void reserveRuns(std::size_t count);      // pre-allocate room for count runs
     int getId() const;           // get component id
+    std::uint32_t getClassValue() const;          // get the class the pixels share
+    void setClassValue(std::uint32_t value);      // set the class the pixels share
     int getNumPixels() const;    // get total pixels in component
-    const std::vector<std::pair<int, int>>& getPixels() const; // get pixel coordinates
+    const std::pmr::vector<PixelRun>& getRuns() const; // get pixel runs
+    const ComponentStats& getStats() const;       // get bounding box, centroid, orientation, compactness
+    PixelRange pixels() const;   // iterate pixel coordinates without expanding the runs
+    const std::vector<std::pair<int, int>>& getPixels() const; // get pixel coordinates (expands the runs)
 		
 
 };
 
+// Deleter for components that may live in an arena: the object is destroyed and its memory
+// returned to the resource it came from, which is a no-op for a monotonic arena
+struct ComponentDeleter {
+   std::pmr::memory_resource* resource = nullptr;   // nullptr: allocated with new
+
+   void operator()(ConnectedComponent* component) const;
+};
+
+using ComponentPtr = std::unique_ptr<ConnectedComponent, ComponentDeleter>;
+
+ComponentPtr makeComponent(std::pmr::memory_resource* resource, int id);   // new component in resource
+ComponentPtr cloneComponent(std::pmr::memory_resource* resource, const ConnectedComponent& other); // deep copy into resource
+
 #endif
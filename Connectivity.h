@@ -0,0 +1,105 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <utility>
+
+/*
+ * Pixel neighbourhoods as compile-time policies.
+ * A policy lists the offsets of a pixel's neighbours in a constexpr array, so loops over
+ * the neighbours are unrolled (forEachOffset) and the run-overlap test of the two-pass
+ * labeler is specialised for it (rowReach, runsTouch). FourConnectivity and
+ * EightConnectivity cover the usual cases; MaskConnectivity builds a policy from a 3x3
+ * mask where bit (dy + 1) * 3 + (dx + 1) enables the neighbour at (dx, dy). Masks must be
+ * symmetric and include the left and right neighbours, since components are stored as
+ * horizontal runs.
+ * The Connectivity enum is the run-time choice; withConnectivity maps it onto a policy.
+ *
+ * */
+
+struct Offset {
+   int dx;
+   int dy;
+};
+
+struct FourConnectivity {
+   static constexpr std::array<Offset, 4> offsets{{{0, -1}, {-1, 0}, {1, 0}, {0, 1}}};
+};
+
+struct EightConnectivity {
+   static constexpr std::array<Offset, 8> offsets{{{-1, -1}, {0, -1}, {1, -1}, {-1, 0},
+                                                   {1, 0}, {-1, 1}, {0, 1}, {1, 1}}};
+};
+
+template <unsigned Mask>
+struct MaskConnectivity {
+   static constexpr unsigned bit(int dx, int dy) { return 1u << ((dy + 1) * 3 + (dx + 1)); }
+
+   static constexpr bool valid() {
+      if (Mask & ~0x1EFu) return false;                                // centre pixel or stray bits
+      if (!(Mask & bit(-1, 0)) || !(Mask & bit(1, 0))) return false;   // runs need row neighbours
+      for (int dy = -1; dy <= 1; ++dy)
+         for (int dx = -1; dx <= 1; ++dx)
+            if (((Mask & bit(dx, dy)) != 0) != ((Mask & bit(-dx, -dy)) != 0)) return false;
+      return true;
+   }
+   static_assert(valid(), "mask must be symmetric, exclude the centre and include left/right neighbours");
+
+   static constexpr std::array<Offset, std::popcount(Mask)> makeOffsets() {
+      std::array<Offset, std::popcount(Mask)> result{};
+      std::size_t i = 0;
+      for (int dy = -1; dy <= 1; ++dy)
+         for (int dx = -1; dx <= 1; ++dx)
+            if (Mask & bit(dx, dy)) result[i++] = {dx, dy};
+      return result;
+   }
+
+   static constexpr auto offsets = makeOffsets();
+};
+
+// Calls fn(offset) for every neighbour offset of the policy, unrolled at compile time.
+template <typename Policy, typename Fn>
+inline void forEachOffset(Fn&& fn) {
+   [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (fn(Policy::offsets[I]), ...);
+   }(std::make_index_sequence<Policy::offsets.size()>{});
+}
+
+// Horizontal reach {lo, hi} of the neighbours in the row above: a run [a, b] can only touch
+// runs of that row that intersect [a + lo, b + hi].
+template <typename Policy>
+constexpr std::pair<int, int> rowReach() {
+   int lo = 1, hi = -1;   // empty when nothing above is a neighbour
+   bool found = false;
+   for (const Offset& o : Policy::offsets) {
+      if (o.dy != -1) continue;
+      lo = (found && lo < o.dx) ? lo : o.dx;
+      hi = (found && hi > o.dx) ? hi : o.dx;
+      found = true;
+   }
+   return {lo, hi};
+}
+
+// True if run [a, b] touches run [c, d] of the row above under the policy.
+template <typename Policy>
+constexpr bool runsTouch(int a, int b, int c, int d) {
+   bool touch = false;
+   for (const Offset& o : Policy::offsets) {
+      if (o.dy == -1) touch |= (c <= b + o.dx && d >= a + o.dx);
+   }
+   return touch;
+}
+
+// Run-time neighbourhood choice
+enum class Connectivity { Four, Eight };
+
+// Calls fn(policy) with the policy object matching connectivity and returns its result.
+template <typename Fn>
+decltype(auto) withConnectivity(Connectivity connectivity, Fn&& fn) {
+   if (connectivity == Connectivity::Eight) return fn(EightConnectivity{});
+   return fn(FourConnectivity{});
+}
+
+#endif
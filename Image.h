@@ -1,18 +1,174 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "ImageFormat.h"
+#include "ColourKernel.h"
+
+struct RGBPixel {
+    unsigned char r, g, b;
+    RGBPixel() : r(0), g(0), b(0) {}
+    RGBPixel(unsigned char r, unsigned char g, unsigned char b) : r(r), g(g), b(b) {}
+};
+
+/*
+ * Image of gray (unsigned char, std::uint16_t or float) or colour (RGBPixel) pixels.
+ * read() accepts every format in the registry (see ImageFormat.h). 8-bit images scale the
+ * samples to 0..255; 16-bit and float images keep the file's values, with the file's maxval
+ * as getMaxValue(). Colour files are converted to gray for gray images and gray files are
+ * expanded to colour for colour images.
+ * write() produces binary PGM (P5) or PPM (P6); float pixels are rounded to 16-bit samples.
+ *
+ * */
+
+template <typename PixelType>
+class Image {
+private:
+    static constexpr bool deep = std::is_same<PixelType, std::uint16_t>::value || std::is_same<PixelType, float>::value;
+
+    std::vector<PixelType> buffer;
+    int width = 0, height = 0;
+    int maxValue = deep ? 65535 : 255;   // largest sample value the pixels are measured against
+
+public:
+    using pixel_type = PixelType;
+    // The gray value type of a pixel, and so of a threshold
+    using sample_type = std::conditional_t<std::is_same<PixelType, RGBPixel>::value, unsigned char, PixelType>;
+
+    Image() = default;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getMaxValue() const { return maxValue; }
+    void setMaxValue(int value) { if (deep && value >= 1 && value <= 65535) maxValue = value; }
+    PixelType* getBuffer() { return buffer.empty() ? nullptr : buffer.data(); }
+    const PixelType* getBuffer() const { return buffer.empty() ? nullptr : buffer.data(); }
+
+    // Copies wd x ht pixels from data
+    void setImageData(const PixelType* data, int wd, int ht) {
+        if (data == nullptr || wd < 1 || ht < 1) {
+            std::cerr << "setImageData() invalid data specified - aborted.\n";
+            return;
+        }
+        buffer.assign(data, data + static_cast<std::size_t>(wd) * ht);
+        width = wd;
+        height = ht;
+    }
+
+    void read(const std::string& fileName);
+    void write(const std::string& fileName) const;
+
+    template <typename T = PixelType>
+    typename std::enable_if<std::is_same<T, RGBPixel>::value, Image<unsigned char>>::type
+    toGrayscale() const;
+};
+
+using PGMImage = Image<unsigned char>;
+using PGM16Image = Image<std::uint16_t>;
+using FloatImage = Image<float>;
+using PPMImage = Image<RGBPixel>;
+
+// Decodes fileName into samples of this image's depth and converts them to its pixel type.
+// On failure the image is left empty and the problem reported on cerr.
+template <typename PixelType>
+void Image<PixelType>::read(const std::string& fileName) {
+    static_assert(std::is_same<PixelType, unsigned char>::value || std::is_same<PixelType, RGBPixel>::value || deep,
+                  "Image::read supports unsigned char, std::uint16_t, float and RGBPixel images");
+    using Decoded = std::conditional_t<deep, std::uint16_t, unsigned char>;
+    buffer.clear();
+    width = height = 0;
+
+    ImageFile file(fileName);
+    if (!file.isOpen()) return;
+    const ImageHeader& header = file.getHeader();
+    const std::size_t pixels = static_cast<std::size_t>(header.width) * header.height;
+
+    std::vector<Decoded> samples(header.sampleCount());
+    if (!file.decode(samples.data())) return;
+
+    if constexpr (std::is_same<PixelType, unsigned char>::value) {
+        if (header.channels() == 3) {
+            buffer.resize(pixels);
+            rgbToGray(samples.data(), buffer.data(), pixels);
+        } else {
+            buffer = std::move(samples);
+        }
+    } else {
+        buffer.resize(pixels);
+        for (std::size_t i = 0; i < pixels; ++i) {
+            if constexpr (std::is_same<PixelType, RGBPixel>::value) {
+                buffer[i] = header.channels() == 3 ? RGBPixel(samples[3 * i], samples[3 * i + 1], samples[3 * i + 2])
+                                                   : RGBPixel(samples[i], samples[i], samples[i]);
+            } else if (header.channels() == 3) {
+                // Same luma weights at full depth; 16-bit pixels truncate like the 8-bit ones
+                const double luma = 0.299 * samples[3 * i] + 0.587 * samples[3 * i + 1] + 0.114 * samples[3 * i + 2];
+                buffer[i] = static_cast<PixelType>(luma);
+            } else {
+                buffer[i] = static_cast<PixelType>(samples[i]);
+            }
+        }
+    }
+    width = header.width;
+    height = header.height;
+    if (deep) maxValue = header.maxval;
+}
+
+// Writes P5 for gray images and P6 for colour ones.
+template <typename PixelType>
+void Image<PixelType>::write(const std::string& fileName) const {
+    if (buffer.empty()) {
+        std::cerr << "Invalid data for image write to " << fileName << std::endl;
+        return;
+    }
+    std::ofstream ofs(fileName, std::ios::binary);
+    if (!ofs) {
+        std::cerr << "Unable to open image output file " << fileName << std::endl;
+        return;
+    }
+    constexpr bool colour = std::is_same<PixelType, RGBPixel>::value;
+    ofs << (colour ? "P6" : "P5") << "\n" << width << " " << height << "\n" << maxValue << "\n";
+    std::vector<unsigned char> samples;
+    if constexpr (colour) {
+        samples.reserve(buffer.size() * 3);
+        for (const RGBPixel& pixel : buffer) {
+            samples.push_back(pixel.r);
+            samples.push_back(pixel.g);
+            samples.push_back(pixel.b);
+        }
+    } else if constexpr (deep) {
+        // One or two big-endian bytes per sample, as the maxval requires
+        samples.reserve(buffer.size() * 2);
+        for (PixelType pixel : buffer) {
+            const int value = static_cast<int>(std::clamp<double>(pixel, 0, maxValue) + 0.5);
+            if (maxValue > 255) samples.push_back(static_cast<unsigned char>(value >> 8));
+            samples.push_back(static_cast<unsigned char>(value & 0xFF));
+        }
+    } else {
+        samples.assign(buffer.begin(), buffer.end());
+    }
+    ofs.write(reinterpret_cast<const char*>(samples.data()), samples.size());
+    if (!ofs) {
+        std::cerr << "Error writing binary block of " << fileName << ".\n";
+    }
+}
+
 template <typename PixelType>
 template <typename T>
 typename std::enable_if<std::is_same<T, RGBPixel>::value, Image<unsigned char>>::type
 Image<PixelType>::toGrayscale() const {
+    static_assert(sizeof(RGBPixel) == 3, "RGBPixel must be three packed bytes");
     Image<unsigned char> result;
-    unsigned char* grayData = new unsigned char[width * height];
-    
-    for (int i = 0; i < width * height; i++) {
-        const RGBPixel& pixel = buffer[i];
-        grayData[i] = static_cast<unsigned char>(
-            0.299 * pixel.r + 0.587 * pixel.g + 0.114 * pixel.b
-        );
-    }
-    
-    result.setImageData(grayData, width, height);
-    delete[] grayData;
+    std::vector<unsigned char> grayData(width * height);
+    rgbToGray(reinterpret_cast<const unsigned char*>(buffer.data()), grayData.data(), grayData.size());
+    result.setImageData(grayData.data(), width, height);
     return result;
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "ImageFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+// Whitespace as defined by the Netpbm formats.
+inline bool isSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline bool isDigit(unsigned char c) { return c >= '0' && c <= '9'; }
+
+// Skips whitespace and '#' comments, which run to the end of the line.
+inline void skipSeparators(const unsigned char* data, std::size_t size, std::size_t& pos) {
+    while (pos < size) {
+        if (data[pos] == '#') {
+            while (pos < size && data[pos] != '\n') ++pos;
+        } else if (isSpace(data[pos])) {
+            ++pos;
+        } else {
+            break;
+        }
+    }
+}
+
+// Parses one unsigned decimal number no larger than limit, starting at pos.
+inline bool parseNumber(const unsigned char* data, std::size_t size, std::size_t& pos, int limit, int& value) {
+    if (pos >= size || !isDigit(data[pos])) return false;
+    int parsed = 0;
+    while (pos < size && isDigit(data[pos])) {
+        parsed = parsed * 10 + (data[pos] - '0');
+        if (parsed > limit) return false;
+        ++pos;
+    }
+    value = parsed;
+    return true;
+}
+
+// Maps sample values 0..maxval to output samples: rescaled to 0..255 for bytes, unchanged
+// for 16-bit samples.
+template <typename Sample>
+class SampleScale {
+    std::vector<unsigned char> table;   // rescaling table, empty when values pass through
+
+public:
+    explicit SampleScale(int maxval) {
+        if (sizeof(Sample) == 1 && maxval != 255) {
+            table.resize(static_cast<std::size_t>(maxval) + 1);
+            for (int v = 0; v <= maxval; ++v) table[v] = static_cast<unsigned char>((v * 255 + maxval / 2) / maxval);
+        }
+    }
+    Sample operator()(int value) const {
+        return table.empty() ? static_cast<Sample>(value) : static_cast<Sample>(table[value]);
+    }
+};
+
+// Decodes whitespace-separated decimal samples.
+template <typename Sample>
+bool decodeAscii(const ImageHeader& header, const unsigned char* data, std::size_t size, Sample* dst) {
+    const SampleScale<Sample> scale(header.maxval);
+    const std::size_t count = header.sampleCount();
+    std::size_t pos = header.rasterOffset;
+    for (std::size_t i = 0; i < count; ++i) {
+        skipSeparators(data, size, pos);
+        int value = 0;
+        if (!parseNumber(data, size, pos, header.maxval, value)) return false;
+        dst[i] = scale(value);
+    }
+    return true;
+}
+
+// Decodes one- or two-byte (big-endian) binary samples.
+template <typename Sample>
+bool decodeBinary(const ImageHeader& header, const unsigned char* data, std::size_t size, Sample* dst) {
+    const std::size_t count = header.sampleCount();
+    const unsigned char* src = data + header.rasterOffset;
+    if (size - header.rasterOffset < count * header.bytesPerSample()) return false;
+
+    if (header.bytesPerSample() == 1) {
+        if (sizeof(Sample) == 1 && header.maxval == 255) {
+            std::memcpy(dst, src, count);   // the common case: bytes straight through
+            return true;
+        }
+        const SampleScale<Sample> scale(header.maxval);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (src[i] > header.maxval) return false;
+            dst[i] = scale(src[i]);
+        }
+        return true;
+    }
+    const SampleScale<Sample> scale(header.maxval);
+    for (std::size_t i = 0; i < count; ++i) {
+        const int value = (src[2 * i] << 8) | src[2 * i + 1];
+        if (value > header.maxval) return false;
+        dst[i] = scale(value);
+    }
+    return true;
+}
+
+}  // namespace
+
+// Returns the number of samples per pixel.
+int ImageHeader::channels() const { return format ? format->channels : 0; }
+
+// Returns the fewest raster bytes that can hold every sample: binary samples have a fixed
+// width and ASCII ones need a digit and a separator. The header caps width and height at
+// 2^24, so the product cannot overflow 64 bits.
+std::uint64_t ImageHeader::minRasterBytes() const {
+    const std::uint64_t samples = static_cast<std::uint64_t>(width) * height * channels();
+    if (format == nullptr || samples == 0) return 0;
+    return format->encoding == SampleEncoding::Binary ? samples * bytesPerSample() : 2 * samples - 1;
+}
+
+// Returns the registry, in magic order.
+const std::vector<ImageFormat>& imageFormats() {
+    static const std::vector<ImageFormat> formats = {
+        {'2', "PGM (ASCII)", 1, SampleEncoding::Ascii, decodeAscii<unsigned char>, decodeAscii<std::uint16_t>},
+        {'3', "PPM (ASCII)", 3, SampleEncoding::Ascii, decodeAscii<unsigned char>, decodeAscii<std::uint16_t>},
+        {'5', "PGM", 1, SampleEncoding::Binary, decodeBinary<unsigned char>, decodeBinary<std::uint16_t>},
+        {'6', "PPM", 3, SampleEncoding::Binary, decodeBinary<unsigned char>, decodeBinary<std::uint16_t>},
+    };
+    return formats;
+}
+
+// Looks up the format from the two-byte magic.
+const ImageFormat* findImageFormat(const unsigned char* data, std::size_t size) {
+    if (size < 2 || data[0] != 'P') return nullptr;
+    for (const ImageFormat& format : imageFormats()) {
+        if (format.magic == static_cast<char>(data[1])) return &format;
+    }
+    return nullptr;
+}
+
+// Parses magic, width, height and maxval, then the single whitespace before the raster.
+bool parseImageHeader(const unsigned char* data, std::size_t size, ImageHeader& header) {
+    const ImageFormat* format = findImageFormat(data, size);
+    if (format == nullptr) return false;
+
+    std::size_t pos = 2;
+    int fields[3] = {0, 0, 0};
+    for (int& field : fields) {
+        skipSeparators(data, size, pos);
+        if (!parseNumber(data, size, pos, 1 << 24, field)) return false;
+    }
+    if (fields[0] < 1 || fields[1] < 1 || fields[2] < 1 || fields[2] > 65535) return false;
+    if (pos >= size || !isSpace(data[pos])) return false;
+
+    header.format = format;
+    header.width = fields[0];
+    header.height = fields[1];
+    header.maxval = fields[2];
+    header.rasterOffset = pos + 1;
+    return true;
+}
+
+// Maps (or failing that, reads) fileName and parses its header.
+ImageFile::ImageFile(const std::string& fileName) : data(nullptr), size(0) {
+    auto file = std::make_shared<const MappedFile>(fileName);
+    if (file->isOpen()) {
+        data = file->getData();
+        size = file->getSize();
+        mapping = std::move(file);
+    } else {
+        std::ifstream ifs(fileName, std::ios::binary);
+        if (!ifs) {
+            std::cerr << "Failed to open file for read: " << fileName << std::endl;
+            return;
+        }
+        contents.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        data = contents.data();
+        size = contents.size();
+    }
+
+    if (findImageFormat(data, size) == nullptr) {
+        const std::string magic = size < 2 ? std::string() : std::string(reinterpret_cast<const char*>(data), 2);
+        std::cerr << "Unrecognised image format in " << fileName << " - magic is: " << magic << std::endl;
+        return;
+    }
+    if (!parseImageHeader(data, size, header)) {
+        std::cerr << "Header not correct - bad size or maxval in " << fileName << std::endl;
+        header = ImageHeader();
+    } else if (getRasterBytes() < header.minRasterBytes()) {
+        std::cerr << "Raster too short for a " << header.width << "x" << header.height << " image in "
+                  << fileName << std::endl;
+        header = ImageHeader();
+    }
+}
+
+// Decodes the raster into 8-bit samples.
+bool ImageFile::decode(unsigned char* dst) const {
+    if (!isOpen() || !header.format->decode8(header, data, size, dst)) {
+        std::cerr << "Failed to read raster - truncated or out of range samples\n";
+        return false;
+    }
+    return true;
+}
+
+// Decodes the raster into 16-bit samples.
+bool ImageFile::decode(std::uint16_t* dst) const {
+    if (!isOpen() || !header.format->decode16(header, data, size, dst)) {
+        std::cerr << "Failed to read raster - truncated or out of range samples\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef IMAGE_FORMAT_H
+#define IMAGE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+/*
+ * Registry of the Netpbm formats the readers understand: ASCII and binary PGM (P2, P5)
+ * and PPM (P3, P6), with any maxval up to 65535. A file's magic picks the format, whose
+ * decoders turn the raster into samples of the width the caller asks for:
+ *   - 8-bit samples are scaled to 0..255 (unchanged when maxval is 255),
+ *   - 16-bit samples keep the file's values (0..maxval).
+ * Binary samples wider than a byte are big-endian, as the format requires. ASCII samples
+ * are parsed by hand rather than with stream extraction.
+ *
+ * */
+
+enum class SampleEncoding { Ascii, Binary };
+
+struct ImageFormat;
+
+struct ImageHeader
+{
+    const ImageFormat* format = nullptr;
+    int width = 0;
+    int height = 0;
+    int maxval = 0;
+    std::size_t rasterOffset = 0;   // first byte after the header
+
+    int channels() const;                               // 1 for PGM, 3 for PPM
+    int bytesPerSample() const { return maxval > 255 ? 2 : 1; }   // binary formats only
+    std::size_t sampleCount() const { return static_cast<std::size_t>(width) * height * channels(); }
+    std::uint64_t minRasterBytes() const;               // smallest raster that can hold every sample
+};
+
+// One registered format. The decoders write header.sampleCount() samples to dst and return
+// false if the raster is truncated or holds a value above maxval.
+struct ImageFormat
+{
+    char magic;                 // digit following 'P'
+    const char* name;
+    int channels;
+    SampleEncoding encoding;
+    bool (*decode8)(const ImageHeader& header, const unsigned char* data, std::size_t size, unsigned char* dst);
+    bool (*decode16)(const ImageHeader& header, const unsigned char* data, std::size_t size, std::uint16_t* dst);
+};
+
+// All registered formats
+const std::vector<ImageFormat>& imageFormats();
+
+// Returns the format whose magic starts data, or nullptr if none matches
+const ImageFormat* findImageFormat(const unsigned char* data, std::size_t size);
+
+// Sniffs the format and parses the header (comments allowed between fields). Returns false
+// for unknown magics, malformed fields, maxval outside 1..65535 or a missing raster separator.
+bool parseImageHeader(const unsigned char* data, std::size_t size, ImageHeader& header);
+
+// Gray level of a colour pixel, with the luma weights used throughout the project
+inline unsigned char grayFromRGB(unsigned char r, unsigned char g, unsigned char b) {
+    return static_cast<unsigned char>(0.299 * r + 0.587 * g + 0.114 * b);
+}
+
+// Whole image file held in memory, memory-mapped where possible and read otherwise, with
+// its header parsed. A raster too short for the header's dimensions is refused here, before
+// any reader allocates for them. Problems are reported on cerr and leave the file closed.
+class ImageFile
+{
+   private:
+      std::shared_ptr<const MappedFile> mapping;   // set when the file is mapped
+      std::vector<unsigned char> contents;         // file bytes when it could not be mapped
+      const unsigned char* data;
+      std::size_t size;
+      ImageHeader header;
+
+   public:
+      explicit ImageFile(const std::string& fileName);
+
+    // methods
+    bool isOpen() const { return header.format != nullptr; }
+    const ImageHeader& getHeader() const { return header; }
+    const ImageFormat& getFormat() const { return *header.format; }
+    const std::shared_ptr<const MappedFile>& getMapping() const { return mapping; }
+    const unsigned char* getRaster() const { return data + header.rasterOffset; }
+    std::size_t getRasterBytes() const { return size - header.rasterOffset; }   // bytes from the raster to the end
+    bool decode(unsigned char* dst) const;      // header.sampleCount() 8-bit samples
+    bool decode(std::uint16_t* dst) const;      // header.sampleCount() 16-bit samples
+};
+
+#endif
@@ -3,78 +3,204 @@
 
 #include "Image.h"
 #include "ConnectedComponent.h"
+#include "ComponentLabeler.h"
+#include "ComponentFilter.h"
+#include "MaxTree.h"
+#include "ThresholdKernel.h"
+#include "ColourKernel.h"
+#include "PaddedMask.h"
+#include "OverlayWriter.h"
+#include "LabelMap.h"
+#include "ComponentExport.h"
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <vector>
 #include <queue>
 #include <algorithm>
 
+// ImageType is any Image<PixelType>: gray images are thresholded and labelled in their own
+// sample type (unsigned char, std::uint16_t or float), colour ones through 8-bit gray.
+// The max-tree engine works on 8-bit levels, so deeper images use two-pass labeling for it.
 template <typename ImageType>
 class ImageProcessor {
+public:
+    using Sample = typename ImageType::sample_type;   // type of gray values and of the threshold
+
 private:
+    static constexpr bool colour = std::is_same<typename ImageType::pixel_type, RGBPixel>::value;
+
     ImageType image;
-    std::vector<std::unique_ptr<ConnectedComponent>> components;
+    // Owns every component and run of the current extraction; declared before components so
+    // it outlives them. Held by pointer so the processor stays movable.
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena =
+        std::make_unique<std::pmr::monotonic_buffer_resource>();
+    std::vector<ComponentPtr> components;
+    mutable ProcessingStats stats;  // per-phase timings and counters, also updated by const writers
+    mutable ComponentSizeIndex sizeIndex;  // sorted sizes, rebuilt on first query after a change
+    std::shared_ptr<const MaxTree> tree;   // component tree of the gray image, built on first use
 
-    void bfs(int x, int y, std::vector<unsigned char>& binaryData, 
-            std::unique_ptr<ConnectedComponent>& component) {
-        std::queue<std::pair<int, int>> q;
-        q.emplace(x, y);
-        const int width = image.getWidth();
-        const int height = image.getHeight();
-        const int dx[] = {0, 0, 1, -1};
-        const int dy[] = {-1, 1, 0, 0};
+    const ComponentSizeIndex& sizes() const {
+        if (!sizeIndex.isBuilt()) sizeIndex.build(components);
+        return sizeIndex;
+    }
+
+    // Flood fill over the Policy's neighbourhood (unrolled); neighbours are a fixed index delta
+    // away and the mask's background frame replaces the bounds tests
+    template <typename Policy>
+    void bfs(int start, PaddedMask& mask, ComponentPtr& component) {
+        std::queue<int> q;
+        q.push(start);
+        const int stride = mask.getStride();
+        STATS_LOCAL(long long pushes = 1;)
+        long long adjacent = 0;   // internal 4-adjacencies, each seen from both ends
 
         while (!q.empty()) {
-            auto [cx, cy] = q.front();
+            const int i = q.front();
             q.pop();
 
-            for (int i = 0; i < 4; ++i) {
-                int nx = cx + dx[i];
-                int ny = cy + dy[i];
-                if (nx >= 0 && nx < width && ny >= 0 && ny < height &&
-                    binaryData[ny * width + nx] == 255) {
-                    binaryData[ny * width + nx] = 0;
-                    component->addPixel(nx, ny);
-                    q.emplace(nx, ny);
+            forEachOffset<Policy>([&](Offset o) {
+                const int n = i + o.dy * stride + o.dx;
+                unsigned char& value = mask[n];
+                if (value != PaddedMask::Background && (o.dx == 0 || o.dy == 0)) adjacent++;
+                if (value == PaddedMask::Foreground) {
+                    value = PaddedMask::Visited;   // still foreground for the adjacency count
+                    component->addPixel(mask.xOf(n), mask.yOf(n));
+                    q.push(n);
+                    STATS_LOCAL(pushes++;)
                 }
-            }
+            });
         }
+        component->addInternalEdges(adjacent / 2);
+        STATS_ADD(&stats, Counter::QueuePushes, pushes);
     }
 
-    unsigned char getGrayValue(int x, int y) const {
-        if constexpr (std::is_same<ImageType, PPMImage>::value) {
-            const RGBPixel& pixel = image.getBuffer()[y * image.getWidth() + x];
-            return static_cast<unsigned char>(0.299 * pixel.r + 0.587 * pixel.g + 0.114 * pixel.b);
+    // Converts row y to gray values, used to threshold colour images a row at a time
+    void fillGrayRow(int y, Sample* gray) const {
+        const size_t width = image.getWidth();
+        if constexpr (colour) {
+            static_assert(sizeof(RGBPixel) == 3, "RGBPixel must be three packed bytes");
+            rgbToGray(reinterpret_cast<const unsigned char*>(image.getBuffer() + y * width), gray, width);
         } else {
-            return image.getBuffer()[y * image.getWidth() + x];
+            std::copy_n(image.getBuffer() + y * width, width, gray);
         }
     }
 
 public:
     explicit ImageProcessor(const std::string& filename) {
+        STATS_TIMER(&stats, Phase::Read);
         image.read(filename);
     }
 
-    int extractComponents(unsigned char threshold, int minValidSize) {
+    ImageProcessor(ImageProcessor&& other) noexcept = default;
+
+    // Releases the old components before the arena they live in is replaced
+    ImageProcessor& operator=(ImageProcessor&& other) noexcept {
+        if (this != &other) {
+            image = std::move(other.image);
+            components.clear();
+            arena = std::move(other.arena);
+            components = std::move(other.components);
+            stats = other.stats;
+            tree = std::move(other.tree);
+            sizeIndex.invalidate();
+            other.sizeIndex.invalidate();
+        }
+        return *this;
+    }
+
+    int extractComponents(Sample threshold, int minValidSize,
+                          const ExtractionOptions& options = ExtractionOptions()) {
         const int width = image.getWidth();
         const int height = image.getHeight();
-        std::vector<unsigned char> binaryData(width * height);
+        reset();
 
-        // Create binary image
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                binaryData[y * width + x] = (getGrayValue(x, y) >= threshold) ? 255 : 0;
+        // The max-tree has 8-bit levels; deeper samples go to the two-pass engine below
+        if constexpr (std::is_same<Sample, unsigned char>::value) {
+            if (options.method == LabelingMethod::MaxTree) {
+                if (!tree || tree->getConnectivity() != options.connectivity) {
+                    // Timed and counted as PGMimageProcessor::maxTree does
+                    STATS_TIMER(&stats, Phase::Label);
+                    STATS_ADD(&stats, Counter::Pixels, static_cast<long long>(width) * height);
+                    if constexpr (!colour) {
+                        tree = std::make_shared<const MaxTree>(image.getBuffer(), width, height, options.connectivity);
+                    } else {
+                        std::vector<unsigned char> gray(static_cast<size_t>(width) * height);
+                        for (int y = 0; y < height; ++y) fillGrayRow(y, gray.data() + static_cast<size_t>(y) * width);
+                        tree = std::make_shared<const MaxTree>(gray.data(), width, height, options.connectivity);
+                    }
+                }
+                STATS_TIMER(&stats, Phase::Label);
+                components = tree->componentsAt(threshold, minValidSize, true, arena.get());
+                STATS_ADD(&stats, Counter::Components, static_cast<long long>(components.size()));
+                STATS_ADD(&stats, Counter::Allocations, static_cast<long long>(components.size()));
+                return components.size();
             }
         }
 
+        if (options.method != LabelingMethod::BFS) {
+            if constexpr (!colour) {
+                // Fused: rows are thresholded while they are labelled, no mask is built
+                STATS_TIMER(&stats, Phase::Label);
+                components = withConnectivity(options.connectivity, [&](auto policy) {
+                    return labelTwoPass<decltype(policy)>(image.getBuffer(), width, height, threshold,
+                                                          minValidSize, true, options.numThreads, &stats,
+                                                          arena.get());
+                });
+            } else {
+                // Colour images are converted to gray a row at a time into a bit-packed mask
+                BitImage mask(width, height);
+                {
+                    STATS_TIMER(&stats, Phase::Threshold);
+                    std::vector<unsigned char> grayRow(width);
+                    for (int y = 0; y < height; ++y) {
+                        fillGrayRow(y, grayRow.data());
+                        thresholdToBitMask(grayRow.data(), mask.row(y), width, threshold);
+                    }
+                    STATS_ADD(&stats, Counter::Pixels, static_cast<long long>(width) * height);
+                }
+                STATS_TIMER(&stats, Phase::Label);
+                components = withConnectivity(options.connectivity, [&](auto policy) {
+                    return labelTwoPass<decltype(policy)>(mask, minValidSize, true, options.numThreads, &stats,
+                                                          arena.get());
+                });
+            }
+            return components.size();
+        }
+
+        // Create binary image for the BFS reference path, framed by background
+        PaddedMask mask(width, height);
+        {
+            STATS_TIMER(&stats, Phase::Threshold);
+            if constexpr (colour) {
+                std::vector<unsigned char> grayRow(width);
+                for (int y = 0; y < height; ++y) {
+                    fillGrayRow(y, grayRow.data());
+                    thresholdToByteMask(grayRow.data(), mask.row(y), width, threshold);
+                }
+            } else {
+                mask.threshold(image.getBuffer(), threshold);
+            }
+            STATS_ADD(&stats, Counter::Pixels, static_cast<long long>(width) * height);
+        }
+
         // Extract components
-        components.clear();
+        STATS_TIMER(&stats, Phase::Label);
         int componentId = 0;
         for (int y = 0; y < height; ++y) {
+            unsigned char* row = mask.row(y);
             for (int x = 0; x < width; ++x) {
-                if (binaryData[y * width + x] == 255) {
-                    auto comp = std::make_unique<ConnectedComponent>(componentId++);
+                if (row[x] == PaddedMask::Foreground) {
+                    auto comp = makeComponent(arena.get(), componentId++);
+                    STATS_ADD(&stats, Counter::Allocations, 1);
+                    STATS_ADD(&stats, Counter::Components, 1);
+                    row[x] = PaddedMask::Visited; // Mark seed visited so it is not added twice
                     comp->addPixel(x, y);
-                    bfs(x, y, binaryData, comp);
+                    if (options.connectivity == Connectivity::Eight) {
+                        bfs<EightConnectivity>(mask.index(x, y), mask, comp);
+                    } else {
+                        bfs<FourConnectivity>(mask.index(x, y), mask, comp);
+                    }
                     if (comp->getNumPixels() >= minValidSize) {
                         components.push_back(std::move(comp));
                     }
@@ -84,27 +210,70 @@ public:
         return components.size();
     }
 
-    int filterComponentsBySize(int minSize, int maxSize) {
-        auto it = components.begin();
-        while (it != components.end()) {
-            int size = (*it)->getNumPixels();
-            if (size < minSize || size > maxSize) {
-                it = components.erase(it);
+    // Class value of a pixel as used by extractClassComponents: 0xRRGGBB for colour images,
+    // the gray value (its bit pattern for float images) otherwise
+    static std::uint32_t classOf(const typename ImageType::pixel_type& pixel) {
+        if constexpr (colour) {
+            return pixelClass(&pixel.r, 3);
+        } else {
+            return pixelClass(&pixel, 1);
+        }
+    }
+
+    // Labels every class of the image in one raster pass: pixels are connected only when they
+    // have the same class value (exact colour or gray level / palette index), and each
+    // component is tagged with its class. Pixels of ignoredClass, usually the background,
+    // form no components. Always run-based, so options.method is not consulted.
+    int extractClassComponents(int minValidSize, std::optional<std::uint32_t> ignoredClass = std::nullopt,
+                               const ExtractionOptions& options = ExtractionOptions()) {
+        reset();
+        STATS_TIMER(&stats, Phase::Label);
+        const auto* pixels = [&] {
+            if constexpr (colour) {
+                static_assert(sizeof(RGBPixel) == 3, "RGBPixel must be three packed bytes");
+                return reinterpret_cast<const unsigned char*>(image.getBuffer());
             } else {
-                ++it;
+                return image.getBuffer();
             }
-        }
+        }();
+        components = withConnectivity(options.connectivity, [&](auto policy) {
+            return labelClasses<decltype(policy)>(pixels, colour ? 3 : 1, image.getWidth(), image.getHeight(),
+                                                  ignoredClass, minValidSize, true, options.numThreads, &stats,
+                                                  arena.get());
+        });
+        return components.size();
+    }
+
+    int filterComponentsBySize(int minSize, int maxSize) {
+        STATS_TIMER(&stats, Phase::Filter);
+        const std::size_t before = components.size();
+        std::erase_if(components, [&](const ComponentPtr& component) {
+            const int size = component->getNumPixels();
+            return size < minSize || size > maxSize;
+        });
+        if (components.size() != before) sizeIndex.invalidate();
         return components.size();
     }
 
+    int filterComponents(const ComponentFilter& filter) {
+        STATS_TIMER(&stats, Phase::Filter);
+        if (filter.apply(components) > 0) sizeIndex.invalidate();
+        return components.size();
+    }
+
+    int countComponentsInRange(int minSize, int maxSize) const {
+        return sizes().countInRange(minSize, maxSize);
+    }
+
     bool writeComponents(const std::string& outFileName) const {
+        STATS_TIMER(&stats, Phase::Write);
         const int width = image.getWidth();
         const int height = image.getHeight();
         std::vector<unsigned char> output(width * height, 0);
 
         for (const auto& comp : components) {
-            for (const auto& [x, y] : comp->getPixels()) {
-                output[y * width + x] = 255;
+            for (const auto& run : comp->getRuns()) {
+                std::fill_n(output.begin() + run.y * width + run.xStart, run.length(), 255);
             }
         }
 
@@ -114,74 +283,73 @@ public:
         return true;
     }
 
+    // Writes each pixel's component number (1-based position in the component list, 0 for
+    // background) as a 16-bit PGM or raw 32-bit label map
+    bool writeLabelMap(const std::string& outFileName, LabelMapFormat format) const {
+        STATS_TIMER(&stats, Phase::Write);
+        return ::writeLabelMap(outFileName, components, image.getWidth(), image.getHeight(), format);
+    }
+
+    // Exports id, class, size, bounding box and centroid of every component as binary, CSV
+    // or JSON records
+    bool writeComponentData(const std::string& outFileName, ComponentDataFormat format) const {
+        STATS_TIMER(&stats, Phase::Write);
+        return ::writeComponentData(outFileName, components, image.getWidth(), image.getHeight(), format);
+    }
+
+    // Streams a PPM of the image with each component's bounding box outlined in red; only
+    // a block of output rows is held at a time
     bool writeComponentsWithBoxes(const std::string& outFileName) const {
+        STATS_TIMER(&stats, Phase::Write);
         const int width = image.getWidth();
         const int height = image.getHeight();
-        std::vector<RGBPixel> output;
-
-        // Handle PGM->PPM conversion
-        if constexpr (std::is_same<ImageType, PGMImage>::value) {
-            const unsigned char* gray = image.getBuffer();
-            output.reserve(width * height);
-            for (int i = 0; i < width * height; ++i) {
-                output.emplace_back(gray[i], gray[i], gray[i]);
-            }
-        } else {
-            const RGBPixel* color = image.getBuffer();
-            output.assign(color, color + width * height);
-        }
 
-        // Draw bounding boxes
-        const RGBPixel red(255, 0, 0);
+        // Bounding boxes, kept up to date by the components while they were labelled
+        OverlayWriter overlay(width, height);
         for (const auto& comp : components) {
-            int minX = width, maxX = 0, minY = height, maxY = 0;
-            for (const auto& [x, y] : comp->getPixels()) {
-                minX = std::min(minX, x);
-                maxX = std::max(maxX, x);
-                minY = std::min(minY, y);
-                maxY = std::max(maxY, y);
-            }
+            const ComponentStats& box = comp->getStats();
+            overlay.addBox(box.minX, box.minY, box.maxX, box.maxY);
+        }
 
-            // Draw box
-            for (int x = minX; x <= maxX; ++x) {
-                output[minY * width + x] = red;
-                output[maxY * width + x] = red;
-            }
-            for (int y = minY; y <= maxY; ++y) {
-                output[y * width + minX] = red;
-                output[y * width + maxX] = red;
+        // Gray rows are expanded to RGB; deeper samples are scaled from 0..maxValue to 0..255
+        const double scale = 255.0 / image.getMaxValue();
+        return overlay.write(outFileName, [&](int y, unsigned char* rgb) {
+            const auto* row = image.getBuffer() + static_cast<size_t>(y) * width;
+            if constexpr (colour) {
+                std::copy_n(reinterpret_cast<const unsigned char*>(row), 3 * static_cast<size_t>(width), rgb);
+            } else {
+                for (int x = 0; x < width; ++x) {
+                    unsigned char level;
+                    if constexpr (std::is_same<Sample, unsigned char>::value) level = row[x];
+                    else level = static_cast<unsigned char>(std::clamp(row[x] * scale, 0.0, 255.0));
+                    rgb[3 * x] = rgb[3 * x + 1] = rgb[3 * x + 2] = level;
+                }
             }
-        }
+        });
+    }
 
-        PPMImage outImage;
-        outImage.setImageData(output.data(), width, height, true);
-        outImage.write(outFileName);
-        return true;
+    // Drops all components and releases the arena's memory in one step
+    void reset() {
+        components.clear();
+        sizeIndex.invalidate();
+        if (arena) arena->release();
+        else arena = std::make_unique<std::pmr::monotonic_buffer_resource>();
     }
 
     int getComponentCount() const { return components.size(); }
-    int getLargestSize() const {
-        return components.empty() ? 0 : 
-            std::max_element(components.begin(), components.end(),
-                [](const auto& a, const auto& b) { 
-                    return a->getNumPixels() < b->getNumPixels(); 
-                })->get()->getNumPixels();
-    }
-    int getSmallestSize() const {
-        return components.empty() ? 0 : 
-            std::min_element(components.begin(), components.end(),
-                [](const auto& a, const auto& b) { 
-                    return a->getNumPixels() < b->getNumPixels(); 
-                })->get()->getNumPixels();
-    }
+    int getLargestSize() const { return sizes().largest(); }
+    int getSmallestSize() const { return sizes().smallest(); }
     void printComponentData(const ConnectedComponent& comp) const {
         std::cout << "Component ID: " << comp.getId() 
                   << ", Pixels: " << comp.getNumPixels() << "\n";
     }
     const auto& getComponents() const { return components; }
+    const ProcessingStats& getStats() const { return stats; }
 };
 
 using PGMProcessor = ImageProcessor<PGMImage>;
+using PGM16Processor = ImageProcessor<PGM16Image>;
+using FloatProcessor = ImageProcessor<FloatImage>;
 using PPMProcessor = ImageProcessor<PPMImage>;
 
 #endif // IMAGE_PROCESSOR_H
\ No newline at end of file
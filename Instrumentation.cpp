@@ -0,0 +1,72 @@
+#include "Instrumentation.h"
+
+namespace {
+
+const char* const phaseNames[] = {"read", "threshold", "label", "filter", "write"};
+const char* const counterNames[] = {"pixels", "runs", "queue_pushes", "allocations", "components"};
+
+}
+
+// Adds one run of a phase taking ns nanoseconds.
+void ProcessingStats::addTime(Phase phase, long long ns) {
+    phaseNs[static_cast<int>(phase)] += ns;
+    phaseCalls[static_cast<int>(phase)]++;
+}
+
+// Adds amount to a counter.
+void ProcessingStats::add(Counter counter, long long amount) { counters[static_cast<int>(counter)] += amount; }
+
+// Returns the total nanoseconds recorded for a phase.
+long long ProcessingStats::getTimeNs(Phase phase) const { return phaseNs[static_cast<int>(phase)]; }
+
+// Returns how many times a phase was recorded.
+long long ProcessingStats::getCalls(Phase phase) const { return phaseCalls[static_cast<int>(phase)]; }
+
+// Returns the value of a counter.
+long long ProcessingStats::get(Counter counter) const { return counters[static_cast<int>(counter)]; }
+
+// Adds all timings and counters of other to this object.
+void ProcessingStats::merge(const ProcessingStats& other) {
+    for (size_t i = 0; i < phaseNs.size(); ++i) {
+        phaseNs[i] += other.phaseNs[i];
+        phaseCalls[i] += other.phaseCalls[i];
+    }
+    for (size_t i = 0; i < counters.size(); ++i) counters[i] += other.counters[i];
+}
+
+// Clears all timings and counters.
+void ProcessingStats::reset() {
+    phaseNs.fill(0);
+    phaseCalls.fill(0);
+    counters.fill(0);
+}
+
+// Prints one line per phase (milliseconds) and per counter.
+void ProcessingStats::print(std::ostream& out) const {
+    if (!enabled) {
+        out << "Statistics are not compiled in (build with STATS=1)\n";
+        return;
+    }
+    out << "Phase timings:\n";
+    for (size_t i = 0; i < phaseNs.size(); ++i) {
+        out << "  " << phaseNames[i] << ": " << phaseNs[i] / 1e6 << " ms (" << phaseCalls[i] << " calls)\n";
+    }
+    out << "Counters:\n";
+    for (size_t i = 0; i < counters.size(); ++i) {
+        out << "  " << counterNames[i] << ": " << counters[i] << "\n";
+    }
+}
+
+// Writes {"enabled": ..., "phases": {...}, "counters": {...}}.
+void ProcessingStats::writeJson(std::ostream& out) const {
+    out << "{\"enabled\": " << (enabled ? "true" : "false") << ", \"phases\": {";
+    for (size_t i = 0; i < phaseNs.size(); ++i) {
+        out << (i ? ", " : "") << "\"" << phaseNames[i] << "\": {\"ns\": " << phaseNs[i]
+            << ", \"calls\": " << phaseCalls[i] << "}";
+    }
+    out << "}, \"counters\": {";
+    for (size_t i = 0; i < counters.size(); ++i) {
+        out << (i ? ", " : "") << "\"" << counterNames[i] << "\": " << counters[i];
+    }
+    out << "}}\n";
+}
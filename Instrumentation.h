@@ -0,0 +1,93 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <array>
+#include <chrono>
+#include <ostream>
+
+/*
+ * Per-phase timings and work counters filled in by the processors. Recording goes
+ * through the STATS_* macros, which expand to nothing unless FINDCOMP_STATS is defined
+ * (make STATS=0 turns it off), so a disabled build pays nothing in the hot loops.
+ * Counters are accumulated in locals inside loops and added once per phase.
+ *
+ * */
+
+// Pipeline phases that are timed
+enum class Phase { Read, Threshold, Label, Filter, Write, Count };
+
+// Work counters
+enum class Counter {
+    Pixels,          // pixels thresholded
+    Runs,            // foreground runs found by the two-pass labeler
+    QueuePushes,     // pixels pushed onto the BFS queue
+    Allocations,     // ConnectedComponent objects allocated
+    Components,      // components found before the minimum size test
+    Count
+};
+
+class ProcessingStats
+{
+   private:
+      std::array<long long, static_cast<int>(Phase::Count)> phaseNs{};
+      std::array<long long, static_cast<int>(Counter::Count)> counters{};
+      std::array<long long, static_cast<int>(Phase::Count)> phaseCalls{};
+
+   public:
+#ifdef FINDCOMP_STATS
+      static constexpr bool enabled = true;
+#else
+      static constexpr bool enabled = false;
+#endif
+
+    // methods
+    void addTime(Phase phase, long long ns);       // record one timed run of a phase
+    void add(Counter counter, long long amount);   // bump a counter
+    long long getTimeNs(Phase phase) const;        // total time spent in a phase
+    long long getCalls(Phase phase) const;         // times a phase was run
+    long long get(Counter counter) const;          // value of a counter
+    void merge(const ProcessingStats& other);      // add another set of statistics to this one
+    void reset();                                  // zero everything
+    void print(std::ostream& out) const;           // human readable table
+    void writeJson(std::ostream& out) const;       // one JSON object
+};
+
+// Adds the lifetime of the object to a phase of a ProcessingStats
+class ScopedTimer
+{
+   private:
+      ProcessingStats* stats;
+      Phase phase;
+      std::chrono::steady_clock::time_point start;
+
+   public:
+      ScopedTimer(ProcessingStats* stats, Phase phase)
+         : stats(stats), phase(phase), start(std::chrono::steady_clock::now()) {}
+      ~ScopedTimer() {
+         if (stats) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            stats->addTime(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+         }
+      }
+      ScopedTimer(const ScopedTimer&) = delete;
+      ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+#define STATS_CONCAT_INNER(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_INNER(a, b)
+
+#ifdef FINDCOMP_STATS
+// Times the rest of the enclosing scope; statsPtr may be null
+#define STATS_TIMER(statsPtr, phase) ScopedTimer STATS_CONCAT(statsTimer, __LINE__)((statsPtr), (phase))
+// Adds amount to a counter; statsPtr may be null
+#define STATS_ADD(statsPtr, counter, amount) \
+    do { if (statsPtr) (statsPtr)->add((counter), (amount)); } while (0)
+// Declares a local that only exists in instrumented builds
+#define STATS_LOCAL(declaration) declaration
+#else
+#define STATS_TIMER(statsPtr, phase) ((void)0)
+#define STATS_ADD(statsPtr, counter, amount) ((void)0)
+#define STATS_LOCAL(declaration)
+#endif
+
+#endif
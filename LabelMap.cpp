@@ -0,0 +1,137 @@
+#include "LabelMap.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr std::uint32_t rawMagic = 0x4D4C4346;   // "FCLM" as little-endian bytes
+constexpr std::uint32_t rawVersion = 1;
+
+// Appends value as four little-endian bytes
+inline void putLittle32(unsigned char* dst, std::uint32_t value) {
+    dst[0] = static_cast<unsigned char>(value);
+    dst[1] = static_cast<unsigned char>(value >> 8);
+    dst[2] = static_cast<unsigned char>(value >> 16);
+    dst[3] = static_cast<unsigned char>(value >> 24);
+}
+
+inline std::uint32_t getLittle32(const unsigned char* src) {
+    return src[0] | (src[1] << 8) | (src[2] << 16) | (static_cast<std::uint32_t>(src[3]) << 24);
+}
+
+// One run with the label it paints
+struct LabelledSpan {
+    int xStart;
+    int xEnd;
+    std::uint32_t label;
+};
+
+}
+
+// Picks the container from the extension.
+LabelMapFormat labelMapFormatFor(const std::string& fileName) {
+    const std::string extension = fileName.size() >= 4 ? fileName.substr(fileName.size() - 4) : "";
+    std::string lower(extension);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    return lower == ".pgm" ? LabelMapFormat::Pgm16 : LabelMapFormat::Raw32;
+}
+
+// Buckets the runs of all components by row, then encodes and writes one row at a time.
+bool writeLabelMap(const std::string& fileName, const std::vector<ComponentPtr>& components,
+                   int width, int height, LabelMapFormat format) {
+    if (width < 1 || height < 1) {
+        std::cerr << "Invalid data for label map write to " << fileName << std::endl;
+        return false;
+    }
+    if (format == LabelMapFormat::Pgm16 && components.size() > 65535) {
+        std::cerr << "Too many components (" << components.size() << ") for a 16-bit label map "
+                  << fileName << " - use a raw label map instead" << std::endl;
+        return false;
+    }
+    std::ofstream ofs(fileName, std::ios::binary);
+    if (!ofs) {
+        std::cerr << "Unable to open label map output file " << fileName << std::endl;
+        return false;
+    }
+
+    // Spans of row y are spans[first[y]..first[y + 1])
+    std::vector<std::size_t> first(height + 1, 0);
+    for (const auto& component : components) {
+        for (const PixelRun& run : component->getRuns()) {
+            if (run.y >= 0 && run.y < height) ++first[run.y + 1];
+        }
+    }
+    for (int y = 0; y < height; ++y) first[y + 1] += first[y];
+    std::vector<LabelledSpan> spans(first.back());
+    std::vector<std::size_t> next(first.begin(), first.end() - 1);
+    for (std::size_t k = 0; k < components.size(); ++k) {
+        for (const PixelRun& run : components[k]->getRuns()) {
+            if (run.y < 0 || run.y >= height) continue;
+            const int xStart = std::max(run.xStart, 0), xEnd = std::min(run.xEnd, width - 1);
+            spans[next[run.y]++] = {xStart, xEnd, static_cast<std::uint32_t>(k + 1)};
+        }
+    }
+
+    const int bytesPerLabel = format == LabelMapFormat::Pgm16 ? 2 : 4;
+    if (format == LabelMapFormat::Pgm16) {
+        ofs << "P5\n" << width << " " << height << "\n65535\n";
+    } else {
+        unsigned char header[20];
+        const std::uint32_t fields[5] = {rawMagic, rawVersion, static_cast<std::uint32_t>(width),
+                                         static_cast<std::uint32_t>(height), static_cast<std::uint32_t>(components.size())};
+        for (int i = 0; i < 5; ++i) putLittle32(header + 4 * i, fields[i]);
+        ofs.write(reinterpret_cast<const char*>(header), sizeof header);
+    }
+
+    std::vector<std::uint32_t> labels(width);
+    std::vector<unsigned char> row(static_cast<std::size_t>(width) * bytesPerLabel);
+    for (int y = 0; y < height; ++y) {
+        std::fill(labels.begin(), labels.end(), 0);
+        for (std::size_t s = first[y]; s < first[y + 1]; ++s) {
+            std::fill(labels.begin() + spans[s].xStart, labels.begin() + spans[s].xEnd + 1, spans[s].label);
+        }
+        for (int x = 0; x < width; ++x) {
+            if (bytesPerLabel == 2) {
+                row[2 * x] = static_cast<unsigned char>(labels[x] >> 8);
+                row[2 * x + 1] = static_cast<unsigned char>(labels[x]);
+            } else {
+                putLittle32(row.data() + 4 * x, labels[x]);
+            }
+        }
+        ofs.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    if (!ofs) {
+        std::cerr << "Error writing label map " << fileName << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Checks the header and decodes the labels.
+bool readLabelMap(const std::string& fileName, std::vector<std::uint32_t>& labels,
+                  int& width, int& height, std::uint32_t& componentCount) {
+    std::ifstream ifs(fileName, std::ios::binary);
+    unsigned char header[20];
+    if (!ifs.read(reinterpret_cast<char*>(header), sizeof header)) return false;
+    if (getLittle32(header) != rawMagic || getLittle32(header + 4) != rawVersion) return false;
+    const std::uint32_t w = getLittle32(header + 8), h = getLittle32(header + 12);
+    if (w < 1 || h < 1 || w > (1u << 24) || h > (1u << 24)) return false;
+
+    // Size the buffers only once the file is known to hold every label
+    const std::uint64_t labelBytes = std::uint64_t{w} * h * 4;   // at most 2^50
+    ifs.seekg(0, std::ios::end);
+    const std::streamoff fileSize = ifs.tellg();
+    if (fileSize < 0 || static_cast<std::uint64_t>(fileSize) - sizeof header < labelBytes) return false;
+    ifs.seekg(sizeof header);
+
+    std::vector<unsigned char> bytes(static_cast<std::size_t>(labelBytes));
+    if (!ifs.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return false;
+    labels.resize(static_cast<std::size_t>(w) * h);
+    for (std::size_t i = 0; i < labels.size(); ++i) labels[i] = getLittle32(bytes.data() + 4 * i);
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    componentCount = getLittle32(header + 16);
+    return true;
+}
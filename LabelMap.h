@@ -0,0 +1,36 @@
+#ifndef LABEL_MAP_H
+#define LABEL_MAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ConnectedComponent.h"
+
+/*
+ * Label-map output: one component number per pixel, so later tools need not label again.
+ * Numbers are dense in the order of the component list, after any filtering: the pixels of
+ * components[k] get k + 1 and everything else 0. The map is written a row at a time from
+ * the components' runs, so no full-size label image is held.
+ * Two containers are supported:
+ *   - Pgm16: binary PGM with maxval 65535 (big-endian), for at most 65535 components;
+ *   - Raw32: a 20-byte header of little-endian uint32 fields (magic "FCLM", version 1,
+ *            width, height, component count) followed by one little-endian uint32 per pixel.
+ *
+ * */
+
+enum class LabelMapFormat { Pgm16, Raw32 };
+
+// Format implied by a file name: Pgm16 for ".pgm", Raw32 otherwise
+LabelMapFormat labelMapFormatFor(const std::string& fileName);
+
+// Writes the label map of components over a width x height image. Returns false (after
+// reporting on cerr) if the file cannot be written or Pgm16 cannot hold the count.
+bool writeLabelMap(const std::string& fileName, const std::vector<ComponentPtr>& components,
+                   int width, int height, LabelMapFormat format);
+
+// Reads a Raw32 label map back. Returns false for a missing, foreign or truncated file.
+bool readLabelMap(const std::string& fileName, std::vector<std::uint32_t>& labels,
+                  int& width, int& height, std::uint32_t& componentCount);
+
+#endif
@@ -0,0 +1,46 @@
+#include "MappedFile.h"
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Maps fileName read-only; on failure the object is left closed.
+MappedFile::MappedFile(const std::string& fileName) : data(nullptr), size(0) {
+#ifdef MAPPED_FILE_POSIX
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(mapping);
+            size = static_cast<std::size_t>(info.st_size);
+            madvise(mapping, size, MADV_SEQUENTIAL); // Rasters are consumed front to back
+        }
+    }
+    close(fd); // The mapping stays valid after the descriptor is closed
+#else
+    (void)fileName;
+#endif
+}
+
+// Unmaps the file.
+MappedFile::~MappedFile() {
+#ifdef MAPPED_FILE_POSIX
+    if (data) munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+// Returns true if the file is mapped.
+bool MappedFile::isOpen() const { return data != nullptr; }
+
+// Returns a pointer to the first byte of the mapping.
+const unsigned char* MappedFile::getData() const { return data; }
+
+// Returns the size of the mapped file in bytes.
+std::size_t MappedFile::getSize() const { return size; }
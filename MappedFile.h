@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Read-only memory mapping of a whole file. The mapping lives as long as the object,
+ * so views into getData() must not outlive it. On platforms without mmap the file is
+ * simply reported as not open and callers fall back to ordinary reads.
+ *
+ * */
+
+class MappedFile
+{
+   private:
+      const unsigned char* data;   // start of the mapping, nullptr if not open
+      std::size_t size;            // length of the file in bytes
+
+   public:
+      explicit MappedFile(const std::string& fileName);
+      ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // methods
+    bool isOpen() const;                  // true if the file was mapped
+    const unsigned char* getData() const; // first byte of the file
+    std::size_t getSize() const;          // file length in bytes
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "MaxTree.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Root of p's tree in the union-find forest, halving the path on the way
+int findRoot(std::vector<int>& zpar, int p) {
+    while (zpar[p] != p) {
+        zpar[p] = zpar[zpar[p]];
+        p = zpar[p];
+    }
+    return p;
+}
+
+// Minimum over ranges of the 256 thresholds: range updates, point queries
+class LevelMin {
+    private:
+        std::array<int, 512> tags;
+
+    public:
+        LevelMin() { tags.fill(INT_MAX); }
+
+        void update(int first, int last, int value) {   // inclusive range
+            for (int l = first + 256, r = last + 257; l < r; l >>= 1, r >>= 1) {
+                if (l & 1) { tags[l] = std::min(tags[l], value); ++l; }
+                if (r & 1) { --r; tags[r] = std::min(tags[r], value); }
+            }
+        }
+
+        int query(int t) const {
+            int result = INT_MAX;
+            for (int i = t + 256; i >= 1; i >>= 1) result = std::min(result, tags[i]);
+            return result;
+        }
+};
+
+// Puts pixel indices of a connected region in raster order with two counting sorts, by
+// column and then stably by row. A connected region spans no more columns or rows than it
+// has pixels, so both passes are linear in its size.
+std::vector<int> rasterOrder(const int* first, const int* last, int width) {
+    int minX = INT_MAX, maxX = INT_MIN, minY = INT_MAX, maxY = INT_MIN;
+    for (const int* p = first; p != last; ++p) {
+        int y = *p / width, x = *p % width;
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+    }
+    std::vector<int> byColumn(last - first), sorted(last - first);
+    if (first == last) return sorted;
+
+    std::vector<int> count(std::max(maxX - minX, maxY - minY) + 2);
+    for (const int* p = first; p != last; ++p) count[*p % width - minX + 1]++;
+    for (int x = 1; x <= maxX - minX; ++x) count[x] += count[x - 1];
+    for (const int* p = first; p != last; ++p) byColumn[count[*p % width - minX]++] = *p;
+
+    std::fill(count.begin(), count.end(), 0);
+    for (int p : byColumn) count[p / width - minY + 1]++;
+    for (int y = 1; y <= maxY - minY; ++y) count[y] += count[y - 1];
+    for (int p : byColumn) sorted[count[p / width - minY]++] = p;
+    return sorted;
+}
+
+}
+
+// Builds the tree: pixels are added from the brightest down and every processed neighbour's
+// tree is hung under the new pixel, then each pixel is pointed at the canonical pixel of its
+// level component. The canonical pixels become the nodes, which are then laid out as an index.
+MaxTree::MaxTree(const unsigned char* gray, int width, int height, Connectivity connectivity)
+    : width(width), height(height), connectivity(connectivity) {
+    const int n = width * height;
+
+    // Counting sort by decreasing level
+    std::vector<int> order(n);
+    std::array<int, 257> start{};
+    for (int p = 0; p < n; ++p) start[gray[p]]++;
+    int offset = 0;
+    for (int v = 255; v >= 0; --v) {
+        int count = start[v];
+        start[v] = offset;
+        offset += count;
+    }
+    for (int p = 0; p < n; ++p) order[start[gray[p]]++] = p;
+
+    std::vector<int> pixelParent(n), pixelArea(n, 1);
+    std::vector<int> zpar(n, -1);   // -1 until the pixel has been processed
+    withConnectivity(connectivity, [&](auto policy) {
+        using Policy = decltype(policy);
+        for (int p : order) {
+            pixelParent[p] = p;
+            zpar[p] = p;
+            const int x = p % width, y = p / width;
+            forEachOffset<Policy>([&](Offset o) {
+                const int nx = x + o.dx, ny = y + o.dy;
+                if (nx < 0 || nx >= width || ny < 0 || ny >= height) return;
+                const int q = ny * width + nx;
+                if (zpar[q] < 0) return;
+                int root = findRoot(zpar, q);
+                if (root != p) {
+                    pixelParent[root] = p;
+                    zpar[root] = p;
+                    pixelArea[p] += pixelArea[root];
+                }
+            });
+        }
+    });
+
+    // Canonicalise from the root down so every pixel points at its node's representative,
+    // numbering the nodes on the way so that parents come before their children
+    std::vector<int>& nodeOf = zpar;
+    for (int i = n - 1; i >= 0; --i) {
+        int p = order[i];
+        int q = pixelParent[p];
+        if (gray[pixelParent[q]] == gray[q]) pixelParent[p] = pixelParent[q];
+        q = pixelParent[p];
+        if (q == p || gray[q] != gray[p]) {
+            nodeOf[p] = static_cast<int>(level.size());
+            level.push_back(gray[p]);
+            parent.push_back(q == p ? nodeOf[p] : nodeOf[q]);
+            area.push_back(pixelArea[p]);
+        } else {
+            nodeOf[p] = nodeOf[q];
+        }
+    }
+    std::vector<int>().swap(order);
+    std::vector<int>().swap(pixelParent);
+    std::vector<int>().swap(pixelArea);
+
+    // Lay the subtrees out as nested spans: a node's own pixels, then each child's span
+    const int nodes = static_cast<int>(level.size());
+    std::vector<int> nextFree(nodes, 0);
+    for (int p = 0; p < n; ++p) nextFree[nodeOf[p]]++;   // own pixel counts
+    spanBegin.assign(nodes, 0);
+    for (int m = 1; m < nodes; ++m) {
+        int own = nextFree[m];
+        spanBegin[m] = nextFree[parent[m]];
+        nextFree[parent[m]] += area[m];
+        nextFree[m] = spanBegin[m] + own;
+    }
+    pixels.resize(n);
+    firstPixel.assign(nodes, INT_MAX);
+    std::vector<int> cursor = spanBegin;
+    for (int p = 0; p < n; ++p) {
+        int m = nodeOf[p];
+        if (firstPixel[m] == INT_MAX) firstPixel[m] = p;
+        pixels[cursor[m]++] = p;
+    }
+    for (int m = nodes - 1; m > 0; --m) firstPixel[parent[m]] = std::min(firstPixel[parent[m]], firstPixel[m]);
+
+    // Children lists
+    childBegin.assign(nodes + 1, 0);
+    for (int m = 1; m < nodes; ++m) childBegin[parent[m] + 1]++;
+    for (int m = 0; m < nodes; ++m) childBegin[m + 1] += childBegin[m];
+    children.resize(nodes > 0 ? nodes - 1 : 0);
+    cursor.assign(childBegin.begin(), childBegin.end() - 1);
+    for (int m = 1; m < nodes; ++m) children[cursor[parent[m]]++] = m;
+}
+
+// Returns the image width.
+int MaxTree::getWidth() const { return width; }
+
+// Returns the image height.
+int MaxTree::getHeight() const { return height; }
+
+// Returns the neighbourhood the tree was built with.
+Connectivity MaxTree::getConnectivity() const { return connectivity; }
+
+// Returns the number of nodes.
+int MaxTree::nodeCount() const { return static_cast<int>(level.size()); }
+
+// Returns the bytes held by the node arrays and the pixel layout.
+std::size_t MaxTree::memoryBytes() const {
+    return level.size() + sizeof(int) * (parent.size() + area.size() + spanBegin.size() + firstPixel.size() +
+                                         childBegin.size() + children.size() + pixels.size());
+}
+
+// Each node of at least minValidSize pixels is a component for thresholds in
+// (parent level, node level]; the per-threshold results are accumulated over those ranges.
+std::vector<ThresholdSummary> MaxTree::sweep(int minValidSize) const {
+    std::vector<std::array<int, 33>> delta(257);   // [0]: count, [1 + k]: histogram bin k
+    std::array<int, 256> largestAt{};              // largest node area per level
+    LevelMin smallest;
+
+    for (int m = 0; m < nodeCount(); ++m) {
+        if (area[m] < minValidSize) continue;
+        const int top = level[m];
+        const int below = (m == 0) ? -1 : level[parent[m]];
+        const int bin = std::bit_width(static_cast<unsigned>(area[m])) - 1;
+        delta[top][0]++;
+        delta[top][1 + bin]++;
+        if (below >= 0) {
+            delta[below][0]--;
+            delta[below][1 + bin]--;
+        }
+        largestAt[top] = std::max(largestAt[top], area[m]);
+        smallest.update(below + 1, top, area[m]);
+    }
+
+    // Walk down from the highest threshold; a node counts for every t at or below its level
+    std::vector<ThresholdSummary> summaries(256);
+    std::array<int, 33> running{};
+    int largest = 0;
+    for (int t = 255; t >= 0; --t) {
+        for (int i = 0; i < 33; ++i) running[i] += delta[t][i];
+        largest = std::max(largest, largestAt[t]);
+        ThresholdSummary& summary = summaries[t];
+        summary.threshold = t;
+        summary.count = running[0];
+        std::copy(running.begin() + 1, running.end(), summary.histogram.begin());
+        if (summary.count > 0) {
+            summary.largest = largest;
+            summary.smallest = smallest.query(t);
+        }
+    }
+    return summaries;
+}
+
+// Finds the nodes that are components at threshold with at least minSize pixels: a node at
+// or above the threshold is one, a node below it is replaced by its children, and subtrees
+// smaller than minSize are skipped whole. Returned in raster order of their first pixel.
+std::vector<int> MaxTree::selectNodes(int threshold, int minSize) const {
+    std::vector<int> selected;
+    if (nodeCount() == 0) return selected;
+    std::vector<int> pending{0};
+    while (!pending.empty()) {
+        int m = pending.back();
+        pending.pop_back();
+        if (area[m] < minSize) continue;
+        if (level[m] >= threshold) {
+            selected.push_back(m);
+        } else {
+            pending.insert(pending.end(), children.begin() + childBegin[m], children.begin() + childBegin[m + 1]);
+        }
+    }
+    std::sort(selected.begin(), selected.end(), [this](int a, int b) { return firstPixel[a] < firstPixel[b]; });
+    return selected;
+}
+
+// Turns a node's pixel span into a component: the pixels are put in raster order, joined
+// into runs, and the adjacencies between consecutive rows are counted for the perimeter.
+ComponentPtr MaxTree::makeComponentFromNode(int node, int id, std::pmr::memory_resource* resource) const {
+    const int* first = pixels.data() + spanBegin[node];
+    std::vector<int> span = rasterOrder(first, first + area[node], width);
+
+    std::vector<PixelRun> runs;
+    for (int p : span) {
+        int y = p / width, x = p % width;
+        if (!runs.empty() && runs.back().y == y && runs.back().xEnd + 1 == x) {
+            runs.back().xEnd = x;
+        } else {
+            runs.push_back({y, x, x});
+        }
+    }
+
+    ComponentPtr component = makeComponent(resource, id);
+    component->reserveRuns(runs.size());
+    size_t rowBegin = 0;                  // first run of the current row
+    size_t aboveBegin = 0, aboveEnd = 0;  // runs of the row directly above, empty if it has none
+    size_t p = 0;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const PixelRun& run = runs[i];
+        if (i == 0 || run.y != runs[i - 1].y) {
+            bool adjacent = i > 0 && runs[i - 1].y == run.y - 1;
+            aboveBegin = adjacent ? rowBegin : i;
+            aboveEnd = i;
+            rowBegin = i;
+            p = aboveBegin;
+        }
+        long long edges = 0;
+        while (p < aboveEnd && runs[p].xEnd < run.xStart) ++p;
+        for (size_t q = p; q < aboveEnd && runs[q].xStart <= run.xEnd; ++q) {
+            edges += std::min(run.xEnd, runs[q].xEnd) - std::max(run.xStart, runs[q].xStart) + 1;
+        }
+        component->addRun(run.y, run.xStart, run.xEnd);
+        component->addInternalEdges(edges);
+    }
+    return component;
+}
+
+// Enumerates the components at one threshold, see MaxTree.h
+std::vector<ComponentPtr> MaxTree::componentsAt(unsigned char threshold, int minValidSize,
+                                                bool countDiscardedIds,
+                                                std::pmr::memory_resource* arena) const {
+    // Ids that count discarded components need every component at this threshold
+    std::vector<int> nodes = selectNodes(threshold, countDiscardedIds ? 1 : minValidSize);
+    std::vector<ComponentPtr> components;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (area[nodes[i]] < minValidSize) continue;
+        int id = countDiscardedIds ? static_cast<int>(i) : static_cast<int>(components.size());
+        components.push_back(makeComponentFromNode(nodes[i], id, arena));
+    }
+    return components;
+}
+
+// Writes the sweep as CSV, one row per summary.
+bool writeThresholdSweep(const std::string& fileName, const std::vector<ThresholdSummary>& summaries) {
+    std::ofstream file;
+    if (fileName != "-") {
+        file.open(fileName);
+        if (!file) return false;
+    }
+    std::ostream& out = (fileName == "-") ? std::cout : file;
+
+    out << "threshold,components,largest,smallest\n";
+    for (const auto& summary : summaries) {
+        out << summary.threshold << ',' << summary.count << ','
+            << summary.largest << ',' << summary.smallest << '\n';
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,80 @@
+#ifndef MAX_TREE_H
+#define MAX_TREE_H
+
+#include "ConnectedComponent.h"
+#include "Connectivity.h"
+#include <array>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+/*
+ * Component tree (max-tree) of a greyscale image.
+ * A node is a connected set of pixels with value >= its level that is maximal at that level;
+ * the parent of a node is the component it becomes part of at the next lower level present.
+ * Connectivity is fixed when the tree is built.
+ * For a threshold t the components of the binary image (pixel >= t) are
+ * exactly the nodes whose level is >= t and whose parent's level is < t, so one tree answers
+ * questions about every threshold at once.
+ * The tree is built with the union-find algorithm of Berger et al. over the pixels in
+ * decreasing order (a counting sort), which costs about as much as one labeling pass.
+ * Once built it is an index: nodes are numbered parents first and the pixels are stored
+ * so that every node's subtree is one contiguous span, so the components at any threshold
+ * and minimum size are found by a descent that stops at the first node at or above the
+ * threshold (or below the minimum size) and are read straight from their spans.
+ *
+ * */
+
+// Components of the binary image at one threshold
+struct ThresholdSummary {
+   int threshold = 0;
+   int count = 0;       // components of at least the minimum size
+   int largest = 0;     // 0 when count is 0
+   int smallest = 0;    // 0 when count is 0
+   std::array<int, 32> histogram{};   // histogram[k]: components with 2^k <= size < 2^(k+1)
+};
+
+class MaxTree
+{
+   private:
+      int width;
+      int height;
+      Connectivity connectivity;
+      // Per node, numbered so that a parent precedes its children (node 0 is the root)
+      std::vector<unsigned char> level;   // grey level of the node
+      std::vector<int> parent;            // parent node, the root is its own parent
+      std::vector<int> area;              // pixels in the node's subtree
+      std::vector<int> spanBegin;         // subtree pixels are pixels[spanBegin, spanBegin + area)
+      std::vector<int> firstPixel;        // smallest raster index in the subtree
+      std::vector<int> childBegin;        // children are children[childBegin[n], childBegin[n + 1])
+      std::vector<int> children;
+      std::vector<int> pixels;            // raster indices in subtree (preorder) layout
+
+      std::vector<int> selectNodes(int threshold, int minSize) const;
+      ComponentPtr makeComponentFromNode(int node, int id, std::pmr::memory_resource* resource) const;
+
+   public:
+      MaxTree(const unsigned char* gray, int width, int height,
+              Connectivity connectivity = Connectivity::Four);
+      ~MaxTree() = default;
+
+    // methods
+    int getWidth() const;
+    int getHeight() const;
+    Connectivity getConnectivity() const;
+    int nodeCount() const;       // number of nodes (distinct components over all thresholds)
+    std::size_t memoryBytes() const;                                // bytes held by the index
+    std::vector<ThresholdSummary> sweep(int minValidSize) const;   // summaries for thresholds 0..255
+
+    // The components of (pixel >= threshold) with at least minValidSize pixels, in raster
+    // order of their first pixel with ids 0, 1, ... exactly as the labelers number them
+    // (countDiscardedIds: smaller components still use up an id, as in ImageProcessor).
+    std::vector<ComponentPtr> componentsAt(unsigned char threshold, int minValidSize,
+                                           bool countDiscardedIds = false,
+                                           std::pmr::memory_resource* arena = std::pmr::get_default_resource()) const;
+};
+
+// Writes threshold,count,largest,smallest CSV rows (to stdout when fileName is "-").
+bool writeThresholdSweep(const std::string& fileName, const std::vector<ThresholdSummary>& summaries);
+
+#endif
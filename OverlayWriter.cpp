@@ -0,0 +1,88 @@
+#include "OverlayWriter.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Target size of one block of rows handed to the stream
+constexpr std::size_t blockBytes = 256 * 1024;
+
+}
+
+OverlayWriter::OverlayWriter(int width, int height, RGBPixel colour)
+    : width(std::max(width, 0)), height(std::max(height, 0)), colour(colour) {}
+
+// Records a box; boxes entirely outside the image are dropped.
+void OverlayWriter::addBox(int minX, int minY, int maxX, int maxY) {
+    if (minX > maxX || minY > maxY || maxX < 0 || maxY < 0 || minX >= width || minY >= height) return;
+    boxes.push_back({std::max(minX, 0), std::max(minY, 0), std::min(maxX, width - 1), std::min(maxY, height - 1)});
+}
+
+// Streams the header and then the rows, drawing the edges of the boxes spanning each row.
+bool OverlayWriter::write(const std::string& fileName, const std::function<void(int, unsigned char*)>& fillRow) const {
+    if (width == 0 || height == 0) {
+        std::cerr << "Invalid data for image write to " << fileName << std::endl;
+        return false;
+    }
+    std::ofstream ofs(fileName, std::ios::binary);
+    if (!ofs) {
+        std::cerr << "Unable to open image output file " << fileName << std::endl;
+        return false;
+    }
+    ofs << "P6\n" << width << " " << height << "\n255\n";
+
+    // Boxes bucketed by top row: those starting on row y are order[first[y]..first[y + 1])
+    std::vector<std::size_t> first(height + 1, 0);
+    for (const Box& box : boxes) ++first[box.minY + 1];
+    for (int y = 0; y < height; ++y) first[y + 1] += first[y];
+    std::vector<std::size_t> order(boxes.size());
+    std::vector<std::size_t> next(first.begin(), first.end() - 1);
+    for (std::size_t i = 0; i < boxes.size(); ++i) order[next[boxes[i].minY]++] = i;
+
+    const std::size_t rowBytes = static_cast<std::size_t>(width) * 3;
+    const int blockRows = static_cast<int>(std::clamp<std::size_t>(blockBytes / rowBytes, 1, height));
+    std::vector<unsigned char> block(rowBytes * blockRows);
+    std::vector<std::size_t> active;   // boxes spanning the current row
+
+    auto paint = [&](unsigned char* row, int xStart, int xEnd) {
+        for (int x = xStart; x <= xEnd; ++x) {
+            row[3 * x] = colour.r;
+            row[3 * x + 1] = colour.g;
+            row[3 * x + 2] = colour.b;
+        }
+    };
+
+    for (int y0 = 0; y0 < height; y0 += blockRows) {
+        const int rows = std::min(blockRows, height - y0);
+        for (int r = 0; r < rows; ++r) {
+            const int y = y0 + r;
+            unsigned char* row = block.data() + r * rowBytes;
+            fillRow(y, row);
+            active.insert(active.end(), order.begin() + first[y], order.begin() + first[y + 1]);
+
+            // Top and bottom rows get the full span, rows in between the two sides
+            for (std::size_t i = 0; i < active.size();) {
+                const Box& box = boxes[active[i]];
+                if (y == box.minY || y == box.maxY) {
+                    paint(row, box.minX, box.maxX);
+                } else {
+                    paint(row, box.minX, box.minX);
+                    paint(row, box.maxX, box.maxX);
+                }
+                if (y == box.maxY) {
+                    active[i] = active.back();
+                    active.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+        }
+        ofs.write(reinterpret_cast<const char*>(block.data()), rows * rowBytes);
+    }
+    if (!ofs) {
+        std::cerr << "Error writing binary block of " << fileName << ".\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef OVERLAY_WRITER_H
+#define OVERLAY_WRITER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+
+/*
+ * Streams a binary PPM (P6) with rectangle outlines drawn over an image, without holding
+ * the whole picture in memory. The caller supplies each row as RGB bytes; the writer draws
+ * the box edges crossing that row and writes rows out in blocks of a few hundred KB.
+ * Boxes are bucketed by their top row once, and a sweep keeps the boxes spanning the
+ * current row, so each row costs its width plus the number of boxes crossing it.
+ *
+ * */
+
+class OverlayWriter
+{
+   private:
+      struct Box { int minX, minY, maxX, maxY; };
+
+      int width, height;
+      RGBPixel colour;           // outline colour
+      std::vector<Box> boxes;
+
+   public:
+      OverlayWriter(int width, int height, RGBPixel colour = RGBPixel(255, 0, 0));
+
+    // methods
+    void addBox(int minX, int minY, int maxX, int maxY);   // inclusive corners, clipped to the image
+    std::size_t getBoxCount() const { return boxes.size(); }
+
+    // Writes the overlay to fileName. fillRow(y, rgb) must fill rgb with the 3 * width
+    // bytes of row y. Returns false (after reporting on cerr) if the file cannot be written.
+    bool write(const std::string& fileName, const std::function<void(int, unsigned char*)>& fillRow) const;
+};
+
+#endif
@@ -6,8 +6,13 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <cctype>
+#include <algorithm>
+#include <vector>
 
 #include "PGMimage.h"
+#include "ImageFormat.h"
+#include "ColourKernel.h"
 
 using namespace std;
 
@@ -27,59 +32,68 @@ void PGMimage::setImageData(unsigned char* data, int wd, int ht) {
     }
     width = wd; height = ht;
     for (int i = 0; i < wd * ht; ++i) buffer[i] = data[i];
+    mapping.reset();
+    view = nullptr;
 }
-void PGMimage::read(const string& fileName)
-{
-    ifstream ifs(fileName, ios::binary);
-    if (!ifs)
-    {
-        cerr << "Failed top open file for read: " << fileName << endl;
-        return;
+
+// Returns the raster for writing. A mapped raster is read-only, so it is copied into an
+// owned buffer first and the mapping is released.
+unsigned char* PGMimage::getBuffer() {
+    if (buffer == nullptr && view != nullptr) {
+        buffer = new unsigned char[width * height];
+        std::copy(view, view + width * height, buffer);
+        mapping.reset();
+        view = nullptr;
     }
-    string line;
-    ifs >> line >> ws;
-    if (line != "P5")
+    return buffer;
+}
+
+// Reads any registered format (see ImageFormat.h): samples are scaled to 8 bits and colour
+// pixels converted to gray. With ReadMode::Map an 8-bit binary PGM raster is used in place
+// in the page cache instead of being copied.
+void PGMimage::read(const string& fileName, ReadMode mode)
+{
+    ImageFile file(fileName);
+    if (!file.isOpen()) return;
+    const ImageHeader& header = file.getHeader();
+    const size_t pixels = static_cast<size_t>(header.width) * header.height;
+
+    clear();
+    if (mode == ReadMode::Map && file.getMapping() && file.getFormat().magic == '5' &&
+        header.maxval == 255 && file.getRasterBytes() >= pixels)
     {
-        cerr << "Malformed PGM file - magic is: " << line << endl;
+        mapping = file.getMapping();
+        view = file.getRaster();
+        width = header.width;
+        height = header.height;
         return;
     }
-    while (getline(ifs, line))
-    {
-        //cout << line << endl;
-        if (line[0] != '#') break;
-		std::cout << line << " ";
-    }
-    istringstream iss(line);
-    iss >> width >> height;
-    //cout << "width, height = (" << width << "," << height << ")\n";
 
-    if (!iss)
+    buffer = new unsigned char[pixels];
+    bool decoded;
+    if (header.channels() == 1)
     {
-        cerr << "Header not correct - unexpected image sizes found: " << line << endl;
-        return;
+        decoded = file.decode(buffer);
     }
-    int maxChan = 0;
-    ifs >> maxChan >> ws;
-    if (maxChan != 255)
+    else
     {
-        cerr << "Max grey level incorect - found: " << maxChan << endl;
+        vector<unsigned char> rgb(header.sampleCount());
+        decoded = file.decode(rgb.data());
+        if (decoded) rgbToGray(rgb.data(), buffer, pixels);
     }
-    // start of binary block
-
-    buffer = new unsigned char[width * height];
-    ifs.read(reinterpret_cast<char*>(buffer), width * height);
-
-    if (!ifs)
+    if (!decoded)
     {
-        cerr << "Failed to read binary block - read\n";
+        clear();
+        return;
     }
-
-    ifs.close();
+    width = header.width;
+    height = header.height;
 }
 
 void PGMimage::write(const string& fileName)
 {
-    if (buffer == nullptr || width < 1 || height < 1)
+    const unsigned char* raster = buffer ? buffer : view;
+    if (raster == nullptr || width < 1 || height < 1)
     {
         cerr << "Invalid data for PGM write to " << fileName << endl;
         return;
@@ -92,11 +106,80 @@ void PGMimage::write(const string& fileName)
     }
 
     ofs << "P5\n#File produced by P Marais\n" << width << " " << height << endl << 255 << endl;
-    ofs.write(reinterpret_cast<char*>(buffer), width * height);
+    ofs.write(reinterpret_cast<const char*>(raster), width * height);
     if (!ofs)
     {
         cerr << "Error writing binary block of PGM.\n";
     }
 
     ofs.close();
+}
+
+// Opens fileName and parses its header with the format registry; the stream is left at the
+// first raster byte. The file is read in growing chunks until the header parses, since a
+// prefix only parses once it holds the separator after maxval.
+PGMrowReader::PGMrowReader(const string& fileName) : ifs(fileName, ios::binary), width(0), height(0), nextRow(0)
+{
+    if (!ifs)
+    {
+        cerr << "Failed top open file for read: " << fileName << endl;
+        return;
+    }
+    vector<unsigned char> prefix;
+    bool parsed = false;
+    for (size_t want = 256; !parsed && ifs; want *= 2)
+    {
+        size_t have = prefix.size();
+        prefix.resize(want);
+        ifs.read(reinterpret_cast<char*>(prefix.data() + have), static_cast<streamsize>(want - have));
+        prefix.resize(have + static_cast<size_t>(ifs.gcount()));
+        parsed = parseImageHeader(prefix.data(), prefix.size(), header);
+    }
+    if (!parsed || header.format->magic != '5')
+    {
+        const string magic(prefix.begin(), prefix.begin() + min<size_t>(2, prefix.size()));
+        cerr << "Streaming needs a binary PGM (P5) file - header not correct in " << fileName
+             << " - magic is: " << magic << endl;
+        header = ImageHeader();
+        return;
+    }
+    ifs.clear();
+    ifs.seekg(static_cast<streamoff>(header.rasterOffset));
+    width = header.width;
+    height = header.height;
+}
+
+// Reads the next band of at most maxRows rows.
+int PGMrowReader::readRows(unsigned char* dst, int maxRows)
+{
+    int rows = min(maxRows, height - nextRow);
+    if (!isOpen() || rows <= 0) return 0;
+
+    // Plain bytes are read straight into dst; other samples are decoded from raw
+    const bool direct = header.maxval == 255;
+    const streamsize rowBytes = static_cast<streamsize>(width) * header.bytesPerSample();
+    if (!direct) raw.resize(static_cast<size_t>(rows) * rowBytes);
+    ifs.read(reinterpret_cast<char*>(direct ? dst : raw.data()), rows * rowBytes);
+    if (!ifs)
+    {
+        cerr << "Failed to read binary block - file truncated after row "
+             << nextRow + ifs.gcount() / rowBytes << " of " << height << "\n";
+        nextRow = height;   // nothing more can be read
+        return -1;
+    }
+    if (!direct)
+    {
+        ImageHeader band = header;
+        band.height = rows;
+        band.rasterOffset = 0;
+        if (!header.format->decode8(band, raw.data(), raw.size(), dst))
+        {
+            cerr << "Failed to read binary block - sample above maxval in rows " << nextRow << " to "
+                 << nextRow + rows - 1 << "\n";
+            nextRow = height;
+            return -1;
+        }
+    }
+    nextRow += rows;
+    return rows;
 }
\ No newline at end of file
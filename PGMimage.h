@@ -5,16 +5,27 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <memory>
+
+#include "ImageFormat.h"
+#include "MappedFile.h"
 
 class PGMimage {
 private:
     unsigned char* buffer;
     int width, height;
+    std::shared_ptr<const MappedFile> mapping;  // keeps a memory-mapped file alive
+    const unsigned char* view;                  // raster inside mapping, when read with ReadMode::Map
+
 public:
-    PGMimage() : buffer(nullptr), width(0), height(0) {}
+    // Copy reads the raster into an owned buffer; Map leaves it in the page cache and
+    // exposes it read-only through getBuffer() const
+    enum class ReadMode { Copy, Map };
+
+    PGMimage() : buffer(nullptr), width(0), height(0), view(nullptr) {}
     ~PGMimage() { if (buffer) delete[] buffer; buffer = nullptr;}
 
-    PGMimage(const PGMimage& other) {
+    PGMimage(const PGMimage& other) : mapping(other.mapping), view(other.view) {
         if (other.buffer) {
             buffer = new unsigned char[other.width * other.height];
             std::copy(other.buffer, other.buffer + (other.width * other.height), buffer);
@@ -34,20 +45,24 @@ public:
         } else {
             buffer = nullptr;
         }
+        mapping = other.mapping; // mapped rasters are read-only, so copies share them
+        view = other.view;
         width = other.width;
         height = other.height;
         return *this;
     }
 
-    unsigned char* getBuffer() { return buffer; }
-    const unsigned char* getBuffer() const { return buffer; }
+    // Writable access; a mapped raster is first copied into an owned buffer
+    unsigned char* getBuffer();
+    const unsigned char* getBuffer() const { return buffer ? buffer : view; }
+    bool isMapped() const { return buffer == nullptr && view != nullptr; }
 
     void getDims(int& wd, int& ht) const {
         wd = width; ht = height;
     }
 
     void setImageData(unsigned char* data, int wd, int ht);
-    void read(const std::string& fileName);
+    void read(const std::string& fileName, ReadMode mode = ReadMode::Copy);
     void write(const std::string& fileName);
     
     void clear() {
@@ -55,9 +70,34 @@ public:
             delete[] buffer;
             buffer = nullptr;
         }
+        mapping.reset();
+        view = nullptr;
         width = 0;
         height = 0;
     }
 };
 
+// Reads the raster of a P5 file a band of rows at a time, for images too large to hold
+// in memory. Only the rows handed to readRows are ever resident. Samples are scaled to
+// 8 bits by the registry's decoder, as PGMimage::read does, so any maxval is accepted.
+class PGMrowReader {
+private:
+    std::ifstream ifs;
+    ImageHeader header;
+    int width, height;
+    int nextRow;        // index of the next row readRows will return
+    std::vector<unsigned char> raw;   // undecoded band when samples are not plain bytes
+public:
+    explicit PGMrowReader(const std::string& fileName);
+
+    bool isOpen() const { return width > 0; }
+    void getDims(int& wd, int& ht) const {
+        wd = width; ht = height;
+    }
+
+    // Reads up to maxRows rows into dst (width bytes each) and returns how many were read:
+    // 0 once every row has been read, -1 if the raster ends before the header's height
+    int readRows(unsigned char* dst, int maxRows);
+};
+
 #endif
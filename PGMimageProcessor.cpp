@@ -3,31 +3,39 @@
 #include <stdexcept>
 #include <queue>
 #include <algorithm>
+#include <utility>
 
 
-// reade the image from file
-PGMimageProcessor::PGMimageProcessor(const std::string& filename) {
-    image.read(filename);
-    if (image.getBuffer() == nullptr) {
+// reade the image from file (memory-mapped by default, so the raster is not copied)
+PGMimageProcessor::PGMimageProcessor(const std::string& filename, PGMimage::ReadMode mode) {
+    STATS_TIMER(&stats, Phase::Read);
+    image.read(filename, mode);
+    if (std::as_const(image).getBuffer() == nullptr) {
         throw std::runtime_error("Failed to read image");
     }
 	image.getDims(imageWidth, imageHeight);
 }
 
 // copy constructor
-PGMimageProcessor::PGMimageProcessor(const PGMimageProcessor& other) : image(other.image) {
+PGMimageProcessor::PGMimageProcessor(const PGMimageProcessor& other)
+    : imageWidth(other.imageWidth), imageHeight(other.imageHeight), image(other.image), stats(other.stats),
+      tree(other.tree) {
     for (const auto& comp : other.components) {
-        components.push_back(std::make_unique<ConnectedComponent>(*comp));
+        components.push_back(cloneComponent(componentArena(), *comp));
     }
 }
 
 // copy assignment
 PGMimageProcessor& PGMimageProcessor::operator=(const PGMimageProcessor& other) {
     if (this != &other) {
+        imageWidth = other.imageWidth;
+        imageHeight = other.imageHeight;
         image = other.image;
-        components.clear();
+        stats = other.stats;
+        tree = other.tree;
+        reset();
         for (const auto& comp : other.components) {
-            components.push_back(std::make_unique<ConnectedComponent>(*comp));
+            components.push_back(cloneComponent(componentArena(), *comp));
         }
     }
     return *this;
@@ -35,38 +43,82 @@ PGMimageProcessor& PGMimageProcessor::operator=(const PGMimageProcessor& other)
 
 // move constructor
 PGMimageProcessor::PGMimageProcessor(PGMimageProcessor&& other) noexcept
-    : image(std::move(other.image)), components(std::move(other.components)) {}
+    : imageWidth(other.imageWidth), imageHeight(other.imageHeight), image(std::move(other.image)),
+      arena(std::move(other.arena)), components(std::move(other.components)), stats(other.stats),
+      tree(std::move(other.tree)) {
+    other.sizeIndex.invalidate();
+}
 
 // move assignment
 PGMimageProcessor& PGMimageProcessor::operator=(PGMimageProcessor&& other) noexcept {
     if (this != &other) {
+        imageWidth = other.imageWidth;
+        imageHeight = other.imageHeight;
         image = std::move(other.image);
+        components.clear();   // release the old components before the arena they live in
+        arena = std::move(other.arena);
         components = std::move(other.components);
+        stats = other.stats;
+        tree = std::move(other.tree);
+        sizeIndex.invalidate();
+        other.sizeIndex.invalidate();
     }
     return *this;
 }
 
-// Extracts connected components from the image based on a threshold and minimum valid size
-int PGMimageProcessor::extractComponents(unsigned char threshold, int minValidSize) {
-    const unsigned char* imageData = image.getBuffer();
+// Extracts connected components from the image based on a threshold and minimum valid size,
+// replacing those of an earlier extraction. Labeling releases the image, so only the MaxTree
+// method (whose tree is kept) can extract again; the others then find no components.
+int PGMimageProcessor::extractComponents(unsigned char threshold, int minValidSize,
+                                         const ExtractionOptions& options) {
+    reset();
+    const unsigned char* imageData = std::as_const(image).getBuffer(); // read-only, may be mapped
 
+    if (options.method == LabelingMethod::MaxTree) {
+        // The tree outlives the image, so the threshold can be changed after image.clear()
+        const MaxTree* index = maxTree(options.connectivity);
+        if (index == nullptr) return 0;
+        STATS_TIMER(&stats, Phase::Label);
+        components = index->componentsAt(threshold, minValidSize, false, componentArena());
+        STATS_ADD(&stats, Counter::Components, static_cast<long long>(components.size()));
+        STATS_ADD(&stats, Counter::Allocations, static_cast<long long>(components.size()));
+        image.clear(); // Free memory from original image
+        return components.size();
+    }
+    if (imageData == nullptr) return 0;   // released by an earlier extraction
 
-    // Create a binary image based on the threshold
-    std::vector<unsigned char> binaryImage(imageWidth * imageHeight);
-    for (int i = 0; i < imageWidth * imageHeight; ++i) {
-        binaryImage[i] = (imageData[i] >= threshold) ? 255 : 0;
+    if (options.method == LabelingMethod::TwoPass) {
+        // Threshold each row as it is labelled, so the image is read once and no mask is built
+        STATS_TIMER(&stats, Phase::Label);
+        auto labelled = withConnectivity(options.connectivity, [&](auto policy) {
+            return labelTwoPass<decltype(policy)>(imageData, imageWidth, imageHeight, threshold, minValidSize,
+                                                  false, options.numThreads, &stats, componentArena());
+        });
+        components = std::move(labelled);
+        image.clear(); // Free memory from original image
+        return components.size();
     }
 
+    // Reference path: traverse each pixel to find connected components using BFS. The image is
+    // thresholded once into a byte mask with a background frame, which also tracks visits
+    STATS_TIMER(&stats, Phase::Label);
+    STATS_ADD(&stats, Counter::Pixels, static_cast<long long>(imageWidth) * imageHeight);
+    PaddedMask mask(imageWidth, imageHeight);
+    mask.threshold(imageData, threshold);
     image.clear(); // Free memory from original image
-
     int componentId = 0;
-    // Traverse each pixel to find connected components using BFS
     for (int y = 0; y < imageHeight; ++y) {
+        const unsigned char* row = mask.row(y);
         for (int x = 0; x < imageWidth; ++x) {
-            int index = y * imageWidth + x;
-            if (binaryImage[index] == 255) {
-                auto component = std::make_unique<ConnectedComponent>(componentId);
-                bfs(x, y, binaryImage, component, imageWidth, imageHeight);
+            if (row[x] == PaddedMask::Foreground) {
+                auto component = makeComponent(componentArena(), componentId);
+                STATS_ADD(&stats, Counter::Allocations, 1);
+                STATS_ADD(&stats, Counter::Components, 1);
+                if (options.connectivity == Connectivity::Eight) {
+                    bfs<EightConnectivity>(mask.index(x, y), mask, component);
+                } else {
+                    bfs<FourConnectivity>(mask.index(x, y), mask, component);
+                }
                 if (component->getNumPixels() >= minValidSize) {
                     components.push_back(std::move(component));
                     componentId++;
@@ -77,64 +129,119 @@ int PGMimageProcessor::extractComponents(unsigned char threshold, int minValidSi
     return components.size(); // Return total valid components found
 }
 
-// Breadth-First Search to group pixels into a connected component
-void PGMimageProcessor::bfs(int startX, int startY, std::vector<unsigned char>& binaryImage,
-                            std::unique_ptr<ConnectedComponent>& component, int width, int height) {
-    std::queue<std::pair<int, int>> q;
-    q.emplace(startX, startY);
-    binaryImage[startY * width + startX] = 0; // Mark as visited
-    component->addPixel(startX, startY);
+// Summarises the components at every threshold (or only the listed ones, clamped to 0..255)
+// from the max-tree of the image, without labeling each threshold separately. Returns an empty
+// vector when there is neither a tree nor an image to build one from (after extraction with
+// another method has released the image).
+std::vector<ThresholdSummary> PGMimageProcessor::sweepThresholds(int minValidSize,
+                                                                  const std::vector<int>& thresholds,
+                                                                  Connectivity connectivity) const {
+    const MaxTree* index = maxTree(connectivity);
+    if (index == nullptr) return {};
+
+    STATS_TIMER(&stats, Phase::Label);
+    std::vector<ThresholdSummary> all = index->sweep(minValidSize);
+    if (thresholds.empty()) return all;
 
-    // 4-connected neighborhood
-    const int dx[] = {0, 0, 1, -1};
-    const int dy[] = {-1, 1, 0, 0};
+    std::vector<ThresholdSummary> selected;
+    selected.reserve(thresholds.size());
+    for (int t : thresholds) selected.push_back(all[std::clamp(t, 0, 255)]);
+    return selected;
+}
+
+// Returns the component tree for the connectivity, building it from the image on first use
+// (nullptr if it is needed but the image has already been released)
+const MaxTree* PGMimageProcessor::maxTree(Connectivity connectivity) const {
+    if (!tree || tree->getConnectivity() != connectivity) {
+        const unsigned char* imageData = image.getBuffer();
+        if (imageData == nullptr) return nullptr;
+        STATS_TIMER(&stats, Phase::Label);
+        STATS_ADD(&stats, Counter::Pixels, static_cast<long long>(imageWidth) * imageHeight);
+        tree = std::make_shared<const MaxTree>(imageData, imageWidth, imageHeight, connectivity);
+    }
+    return tree.get();
+}
+
+// Breadth-First Search to group pixels into a connected component. The neighbourhood is the
+// Policy's (see Connectivity.h) and its loop is unrolled; neighbours are found by adding a fixed
+// delta to the cell index, the mask's background frame standing in for the bounds tests.
+template <typename Policy>
+void PGMimageProcessor::bfs(int start, PaddedMask& mask, ComponentPtr& component) {
+    const int stride = mask.getStride();
+    std::queue<int> q;
+    q.push(start);
+    mask[start] = PaddedMask::Visited; // Mark as visited
+    component->addPixel(mask.xOf(start), mask.yOf(start));
+
+    STATS_LOCAL(long long pushes = 1;)
+    long long adjacent = 0;   // every 4-adjacent pair inside the component is seen from both ends
 
     // Explore all connected pixels
     while (!q.empty()) {
-        auto [x, y] = q.front();
+        const int i = q.front();
         q.pop();
 
-        for (int i = 0; i < 4; ++i) {
-            int nx = x + dx[i];
-            int ny = y + dy[i];
-            if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                int index = ny * width + nx;
-                if (binaryImage[index] == 255) {
-                    binaryImage[index] = 0; // Mark as visited
-                    component->addPixel(nx, ny);
-                    q.emplace(nx, ny);
-                }
+        forEachOffset<Policy>([&](Offset o) {
+            const int n = i + o.dy * stride + o.dx;
+            const unsigned char cell = mask[n];
+            if (cell == PaddedMask::Background) return;
+            if (o.dx == 0 || o.dy == 0) adjacent++;
+            if (cell == PaddedMask::Foreground) {
+                mask[n] = PaddedMask::Visited; // Mark as visited
+                component->addPixel(mask.xOf(n), mask.yOf(n));
+                q.push(n);
+                STATS_LOCAL(pushes++;)
             }
-        }
+        });
     }
+    component->addInternalEdges(adjacent / 2);
+    STATS_ADD(&stats, Counter::QueuePushes, pushes);
 }
 
 // Filtering out components smaller or larger than the specified size range
 int PGMimageProcessor::filterComponentsBySize(int minSize, int maxSize) {
-    auto it = components.begin();
-    while (it != components.end()) {
-        int size = (*it)->getNumPixels();
-        if (size < minSize || size > maxSize) {
-            it = components.erase(it); // Remove if outside range
-        } else {
-            ++it;
-        }
-    }
+    STATS_TIMER(&stats, Phase::Filter);
+    const std::size_t before = components.size();
+    std::erase_if(components, [&](const ComponentPtr& component) {
+        const int size = component->getNumPixels();
+        return size < minSize || size > maxSize;
+    });
+    if (components.size() != before) sizeIndex.invalidate();
     return components.size(); // Return count of remaining components
 }
 
+// Removes every component the filter rejects in one compacting pass
+int PGMimageProcessor::filterComponents(const ComponentFilter& filter) {
+    STATS_TIMER(&stats, Phase::Filter);
+    if (filter.apply(components) > 0) sizeIndex.invalidate();
+    return components.size(); // Return count of remaining components
+}
+
+// Returns the number of components whose size lies in [minSize, maxSize]
+int PGMimageProcessor::countComponentsInRange(int minSize, int maxSize) const {
+    return sizes().countInRange(minSize, maxSize);
+}
+
+// Returns the size index, building it if the components changed since the last query
+const ComponentSizeIndex& PGMimageProcessor::sizes() const {
+    if (!sizeIndex.isBuilt()) sizeIndex.build(components);
+    return sizeIndex;
+}
+
 // Writes the binary image showing all components to a PGM file
 bool PGMimageProcessor::writeComponents(const std::string& outFileName) const {
+    STATS_TIMER(&stats, Phase::Write);
     std::vector<unsigned char> outputImage(imageWidth * imageHeight, 0); // Black background
 
     // Set component pixels to white (255)
      for (const auto& component : components) {
-        for (const auto& [x, y] : component->getPixels()) {
-            // Validate (x, y) before writing
-            if (x >= 0 && x < imageWidth && y >= 0 && y < imageHeight) {
-                outputImage[y * imageWidth + x] = 255;
+        for (const auto& run : component->getRuns()) {
+            // Validate the run before writing
+            if (run.xStart >= 0 && run.xEnd < imageWidth && run.y >= 0 && run.y < imageHeight) {
+                std::fill_n(outputImage.begin() + run.y * imageWidth + run.xStart, run.length(), 255);
             } else {
-                std::cerr << "Warning: Skipping invalid pixel (" << x << ", " << y << ")\n";
+                std::cerr << "Warning: Skipping invalid run (" << run.xStart << "-" << run.xEnd
+                          << ", " << run.y << ")\n";
             }
         }
     }
@@ -148,31 +255,52 @@ bool PGMimageProcessor::writeComponents(const std::string& outFileName) const {
     return true;
 }
 
+// Writes each pixel's component number (1-based position in the component list, 0 for
+// background) as a 16-bit PGM or raw 32-bit label map
+bool PGMimageProcessor::writeLabelMap(const std::string& outFileName, LabelMapFormat format) const {
+    STATS_TIMER(&stats, Phase::Write);
+    return ::writeLabelMap(outFileName, components, imageWidth, imageHeight, format);
+}
+
+// Exports id, class, size, bounding box and centroid of every component as binary, CSV or
+// JSON records
+bool PGMimageProcessor::writeComponentData(const std::string& outFileName, ComponentDataFormat format) const {
+    STATS_TIMER(&stats, Phase::Write);
+    return ::writeComponentData(outFileName, components, imageWidth, imageHeight, format);
+}
+
+
+// Drops all components and frees their storage in one step by releasing the arena
+void PGMimageProcessor::reset() {
+    components.clear();
+    sizeIndex.invalidate();
+    if (arena) arena->release();
+}
+
+// Returns the arena components are allocated from, creating it on first use
+std::pmr::memory_resource* PGMimageProcessor::componentArena() {
+    if (!arena) arena = std::make_unique<std::pmr::monotonic_buffer_resource>();
+    return arena.get();
+}
 
 // Returns the total number of connected components
 int PGMimageProcessor::getComponentCount() const { return components.size(); }
 
 // Returns the size of the largest component
-int PGMimageProcessor::getLargestSize() const {
-    if (components.empty()) return 0;
-    return std::max_element(components.begin(), components.end(),
-        [](const auto& a, const auto& b) { return a->getNumPixels() < b->getNumPixels(); })->get()->getNumPixels();
-}
+int PGMimageProcessor::getLargestSize() const { return sizes().largest(); }
 
 // Returns the size of the smallest component
-int PGMimageProcessor::getSmallestSize() const {
-    if (components.empty()) return 0;
-    return std::min_element(components.begin(), components.end(),
-        [](const auto& a, const auto& b) { return a->getNumPixels() < b->getNumPixels(); })->get()->getNumPixels();
-}
+int PGMimageProcessor::getSmallestSize() const { return sizes().smallest(); }
 
 // Prints the ID and pixel count of a given component
 void PGMimageProcessor::printComponentData(const ConnectedComponent& theComponent) const {
     std::cout << "Component ID: " << theComponent.getId()
-              << ", Number of pixels: " << theComponent.getNumPixels() << std::endl;
+              << ", Number of pixels: " << theComponent.getNumPixels() << '\n';
 }
 
 // Returns a const reference to all extracted connected components
-const std::vector<std::unique_ptr<ConnectedComponent>>& PGMimageProcessor::getComponents() const {
+const std::vector<ComponentPtr>& PGMimageProcessor::getComponents() const {
     return components;
-}
\ No newline at end of file
+}
+// Returns the timings and counters recorded so far (all zero unless built with FINDCOMP_STATS)
+const ProcessingStats& PGMimageProcessor::getStats() const { return stats; }
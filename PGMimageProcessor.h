@@ -1,7 +1,15 @@
 #ifndef PGM_IMAGE_PROCESSOR_H
 #define PGM_IMAGE_PROCESSOR_H
 #include "ConnectedComponent.h"
+#include "ComponentLabeler.h"
+#include "ComponentFilter.h"
+#include "MaxTree.h"
+#include "Instrumentation.h"
+#include "PaddedMask.h"
+#include "LabelMap.h"
+#include "ComponentExport.h"
 #include <memory>
+#include <memory_resource>
 #include <vector>
 #include <string>
 #include "PGMimage.h"
@@ -11,12 +19,23 @@ private:
 	int imageWidth;
     int imageHeight;
     PGMimage image;
-    std::vector<std::unique_ptr<ConnectedComponent>> components;
-    void bfs(int x, int y, std::vector<unsigned char>& binaryImage, std::unique_ptr<ConnectedComponent>& component, int width, int height);
+    // Owns every component and run until reset(); declared before components so it outlives
+    // them, and held by pointer so the processor can be moved
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+    std::vector<ComponentPtr> components;
+    mutable ProcessingStats stats;  // per-phase timings and counters, also updated by const writers
+    mutable ComponentSizeIndex sizeIndex;  // sorted sizes, rebuilt on first query after a change
+    mutable std::shared_ptr<const MaxTree> tree;  // component tree, built on first use and kept
+    const ComponentSizeIndex& sizes() const;
+    const MaxTree* maxTree(Connectivity connectivity) const;
+    template <typename Policy>
+    void bfs(int start, PaddedMask& mask, ComponentPtr& component);
+    std::pmr::memory_resource* componentArena();
 
     
 public:
-    explicit PGMimageProcessor(const std::string& filename);
+    explicit PGMimageProcessor(const std::string& filename,
+                               PGMimage::ReadMode mode = PGMimage::ReadMode::Map);
     ~PGMimageProcessor() = default;
 
     PGMimageProcessor(const PGMimageProcessor& other);
@@ -24,14 +43,23 @@ public:
     PGMimageProcessor(PGMimageProcessor&& other) noexcept;
     PGMimageProcessor& operator=(PGMimageProcessor&& other) noexcept;
 
-    int extractComponents(unsigned char threshold, int minValidSize);
+    int extractComponents(unsigned char threshold, int minValidSize,
+                          const ExtractionOptions& options = ExtractionOptions());
+    std::vector<ThresholdSummary> sweepThresholds(int minValidSize, const std::vector<int>& thresholds = {},
+                                                  Connectivity connectivity = Connectivity::Four) const;
     int filterComponentsBySize(int minSize, int maxSize);
+    int filterComponents(const ComponentFilter& filter);
+    int countComponentsInRange(int minSize, int maxSize) const;
     bool writeComponents(const std::string& outFileName) const;
+    bool writeLabelMap(const std::string& outFileName, LabelMapFormat format) const;
+    bool writeComponentData(const std::string& outFileName, ComponentDataFormat format) const;
+    void reset();
     int getComponentCount() const;
     int getLargestSize() const;
     int getSmallestSize() const;
     void printComponentData(const ConnectedComponent& theComponent) const;
-    const std::vector<std::unique_ptr<ConnectedComponent>>& getComponents() const;
+    const std::vector<ComponentPtr>& getComponents() const;
+    const ProcessingStats& getStats() const;
 };
 
 #endif
@@ -0,0 +1,47 @@
+#include "PaddedMask.h"
+#include "ThresholdKernel.h"
+
+// Creates a width x height mask with every cell, frame included, set to background.
+PaddedMask::PaddedMask(int width, int height)
+    : width(width), height(height), stride(width + 2),
+      cells(static_cast<std::size_t>(stride) * (height + 2), Background) {}
+
+// Returns the image width in pixels, without the frame.
+int PaddedMask::getWidth() const { return width; }
+
+// Returns the image height in pixels, without the frame.
+int PaddedMask::getHeight() const { return height; }
+
+// Returns the number of cells per row.
+int PaddedMask::getStride() const { return stride; }
+
+// Returns a pointer to the cell of pixel (0, y).
+unsigned char* PaddedMask::row(int y) { return cells.data() + index(0, y); }
+
+namespace {
+
+// Thresholds each row of gray into the cells of the matching mask row.
+template <typename Sample>
+void thresholdRows(PaddedMask& mask, const Sample* gray, Sample threshold) {
+    const int width = mask.getWidth();
+    for (int y = 0; y < mask.getHeight(); ++y) {
+        thresholdToByteMask(gray + static_cast<std::size_t>(y) * width, mask.row(y), width, threshold);
+    }
+}
+
+}
+
+// Fills the image cells from a width x height grayscale buffer; the frame stays background.
+void PaddedMask::threshold(const unsigned char* gray, unsigned char threshold) {
+    thresholdRows(*this, gray, threshold);
+}
+
+// Same for 16-bit samples.
+void PaddedMask::threshold(const std::uint16_t* gray, std::uint16_t threshold) {
+    thresholdRows(*this, gray, threshold);
+}
+
+// Same for float samples.
+void PaddedMask::threshold(const float* gray, float threshold) {
+    thresholdRows(*this, gray, threshold);
+}
@@ -0,0 +1,49 @@
+#ifndef PADDED_MASK_H
+#define PADDED_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Byte-per-pixel binary image surrounded by a one-pixel frame of background, used by the
+ * BFS flood fills. Because every pixel of the image has all eight neighbours in memory
+ * (frame pixels are simply never foreground), a neighbour is reached by adding a fixed
+ * index delta (dy * stride + dx) and the hot loop needs no bounds checks.
+ * Cells are Background (0), Foreground (255, not yet visited) or Visited (1); Visited is
+ * non-zero so visited pixels still count as foreground neighbours.
+ *
+ * */
+
+class PaddedMask
+{
+   public:
+      static constexpr unsigned char Background = 0;
+      static constexpr unsigned char Visited = 1;
+      static constexpr unsigned char Foreground = 255;
+
+   private:
+      int width;
+      int height;
+      int stride;                         // width + 2
+      std::vector<unsigned char> cells;   // (height + 2) rows of stride cells
+
+   public:
+      PaddedMask(int width, int height);
+      ~PaddedMask() = default;
+
+    // methods
+    int getWidth() const;
+    int getHeight() const;
+    int getStride() const;                          // cells per row, frame included
+    int index(int x, int y) const { return (y + 1) * stride + x + 1; }   // cell of pixel (x, y)
+    int xOf(int index) const { return index % stride - 1; }
+    int yOf(int index) const { return index / stride - 1; }
+    unsigned char& operator[](int index) { return cells[index]; }
+    unsigned char* row(int y);                      // pixel (0, y); the frame is at [-1] and [width]
+    void threshold(const unsigned char* gray, unsigned char threshold);   // pixel = gray >= threshold
+    void threshold(const std::uint16_t* gray, std::uint16_t threshold);
+    void threshold(const float* gray, float threshold);
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "StreamingExtractor.h"
+#include "BitImage.h"
+#include "PGMimage.h"
+#include "ThresholdKernel.h"
+#include <algorithm>
+
+// Prepares to stream fileName, reading bandRows rows per read call.
+StreamingExtractor::StreamingExtractor(const std::string& fileName, int bandRows, Connectivity connectivity)
+    : fileName(fileName), bandRows(std::max(1, bandRows)), connectivity(connectivity) {}
+
+// Returns a fresh slot, reusing one of a completed component when possible.
+int StreamingExtractor::newSlot() {
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<int>(slots.size());
+        slots.emplace_back();
+    }
+    slots[slot] = Slot{ComponentStats(), slot, -1};
+    return slot;
+}
+
+// Returns the root slot of a component, compressing the path on the way.
+int StreamingExtractor::findRoot(int slot) {
+    while (slots[slot].parent != slot) {
+        slots[slot].parent = slots[slots[slot].parent].parent;
+        slot = slots[slot].parent;
+    }
+    return slot;
+}
+
+// Labels the image row by row and reports components as they complete.
+int StreamingExtractor::extract(unsigned char threshold, int minValidSize,
+                                const ComponentCallback& onComponent) {
+    PGMrowReader reader(fileName);
+    if (!reader.isOpen()) return -1;
+    int width, height;
+    reader.getDims(width, height);
+
+    slots.clear();
+    freeSlots.clear();
+    std::vector<unsigned char> band(static_cast<size_t>(bandRows) * width);
+    BitImage rowMask(width, 1);
+    std::vector<SlotRun> previous, current;
+    std::vector<int> live, stillLive;   // root slots present on the previous / current row
+    // A run [a, b] touches the runs of the row above that intersect [a + lo, b + hi]
+    const auto [lo, hi] = withConnectivity(connectivity, [](auto policy) { return rowReach<decltype(policy)>(); });
+    int reported = 0;
+
+    auto complete = [&](int slot) {
+        if (slots[slot].stats.area >= minValidSize) onComponent(reported++, slots[slot].stats);
+    };
+
+    int y = 0;
+    int rowsInBand = 0;
+    while ((rowsInBand = reader.readRows(band.data(), bandRows)) > 0) {
+        for (int r = 0; r < rowsInBand; ++r, ++y) {
+            thresholdToBitMask(band.data() + static_cast<size_t>(r) * width, rowMask.row(0), width, threshold);
+
+            // Label the row's runs against the runs of the row above; only overlapping
+            // columns share an edge, diagonal contacts join runs without adding one
+            current.clear();
+            size_t p = 0;
+            rowMask.forEachRun(0, [&](int xStart, int xEnd) {
+                while (p < previous.size() && previous[p].xEnd < xStart + lo) ++p;
+                int root = -1;
+                long long verticalEdges = 0;
+                for (size_t q = p; q < previous.size() && previous[q].xStart <= xEnd + hi; ++q) {
+                    verticalEdges += std::max(0, std::min(xEnd, previous[q].xEnd) - std::max(xStart, previous[q].xStart) + 1);
+                    int other = findRoot(previous[q].slot);
+                    if (root < 0) {
+                        root = other;
+                    } else if (other != root) {
+                        slots[root].stats.merge(slots[other].stats);
+                        slots[other].parent = root;
+                    }
+                }
+                if (root < 0) root = newSlot();
+                slots[root].stats.addRun(y, xStart, xEnd);
+                slots[root].stats.addInternalEdges(verticalEdges);
+                current.push_back({xStart, xEnd, root});
+            });
+
+            // Point every run at its final root and note which components reached this row
+            stillLive.clear();
+            for (auto& run : current) {
+                run.slot = findRoot(run.slot);
+                if (slots[run.slot].seenRow != y) {
+                    slots[run.slot].seenRow = y;
+                    stillLive.push_back(run.slot);
+                }
+            }
+
+            // Components from the row above that were not continued are complete; slots
+            // merged into another component are no longer referenced and can be reused
+            for (int slot : live) {
+                if (slots[slot].seenRow == y) continue;
+                if (slots[slot].parent == slot) complete(slot);
+                freeSlots.push_back(slot);
+            }
+            live.swap(stillLive);
+            previous.swap(current);
+        }
+    }
+
+    if (rowsInBand < 0) return -1;   // truncated raster: the open components are incomplete
+
+    for (int slot : live) complete(slot);
+    return reported;
+}
@@ -0,0 +1,63 @@
+#ifndef STREAMING_EXTRACTOR_H
+#define STREAMING_EXTRACTOR_H
+
+#include "ComponentStats.h"
+#include "Connectivity.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Component extraction for images larger than memory. The PGM raster is read a band of
+ * rows at a time and labelled run by run; only the previous row's runs and a table of the
+ * components that can still grow are kept. A component is reported through the callback
+ * (with its size, bounding box and centroid) as soon as a row passes without touching it.
+ *
+ * Runs are joined under the chosen connectivity, as in labelTwoPass.
+ * Pixels are not retained, so memory is O(width) regardless of the image height.
+ * Components are numbered in the order they complete, not in raster order.
+ *
+ * */
+
+class StreamingExtractor
+{
+   public:
+      using ComponentCallback = std::function<void(int id, const ComponentStats& stats)>;
+
+   private:
+      // A component that may still grow; slots are recycled once a component completes
+      struct Slot {
+         ComponentStats stats;
+         int parent;     // union-find parent slot, a root points to itself
+         int seenRow;    // last row a run of this (root) component was found on
+      };
+
+      // A run of the previous or current row and the slot it belongs to
+      struct SlotRun {
+         int xStart;
+         int xEnd;
+         int slot;
+      };
+
+      std::string fileName;
+      int bandRows;
+      Connectivity connectivity;
+      std::vector<Slot> slots;
+      std::vector<int> freeSlots;
+
+      int newSlot();
+      int findRoot(int slot);
+
+   public:
+      explicit StreamingExtractor(const std::string& fileName, int bandRows = 64,
+                                  Connectivity connectivity = Connectivity::Four);
+      ~StreamingExtractor() = default;
+
+    // Streams the image, reporting each component of at least minValidSize pixels.
+    // Returns the number of components reported, or -1 if the file could not be read or
+    // its raster is shorter than the header says (components completed before the end of
+    // the data have been reported by then).
+    int extract(unsigned char threshold, int minValidSize, const ComponentCallback& onComponent);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Starts numThreads workers (all hardware threads when numThreads is 0).
+ThreadPool::ThreadPool(int numThreads) : running(0), stopping(false) {
+    if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < numThreads; ++i) workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+// Lets the workers finish the queue, then joins them.
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+// Pops and runs tasks until the pool is stopping and the queue is empty.
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+            running++;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            if (running == 0 && tasks.empty()) allDone.notify_all();
+        }
+    }
+}
+
+// Queues a task to be run by the next free worker.
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    taskReady.notify_one();
+}
+
+// Waits until every submitted task has finished.
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this] { return running == 0 && tasks.empty(); });
+}
+
+// Returns the number of worker threads.
+int ThreadPool::size() const { return static_cast<int>(workers.size()); }
+
+// Returns the process-wide pool, creating it on first use.
+ThreadPool& sharedThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Creates a budget of capacity bytes.
+MemoryBudget::MemoryBudget(std::size_t capacity) : capacity(capacity), inUse(0) {}
+
+// Waits until bytes more fit, or until nothing is held when bytes exceeds the capacity.
+void MemoryBudget::acquire(std::size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [&] { return inUse == 0 || inUse + bytes <= capacity; });
+    inUse += bytes;
+}
+
+// Returns bytes to the budget and wakes any waiters.
+void MemoryBudget::release(std::size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inUse -= std::min(bytes, inUse);
+    }
+    released.notify_all();
+}
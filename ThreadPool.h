@@ -0,0 +1,108 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads draining a shared task queue. Threads are started once
+ * and reused for every submitted task until the pool is destroyed.
+ *
+ * */
+
+class ThreadPool
+{
+   private:
+      std::vector<std::thread> workers;
+      std::queue<std::function<void()>> tasks;
+      std::mutex mutex;
+      std::condition_variable taskReady;   // signalled when a task is queued or the pool stops
+      std::condition_variable allDone;     // signalled when the last running task finishes
+      int running;                         // tasks currently being executed
+      bool stopping;
+
+      void workerLoop();
+
+   public:
+      explicit ThreadPool(int numThreads = 0);   // 0 = hardware_concurrency
+      ~ThreadPool();                             // finishes queued tasks, then joins
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // methods
+    void submit(std::function<void()> task);   // queue a task for any worker
+    void wait();                               // block until the queue is empty and all tasks finished
+    int size() const;                          // number of worker threads
+};
+
+// Pool shared by the data-parallel loops of the labelers, started on first use with one
+// worker per hardware thread and kept for the life of the process
+ThreadPool& sharedThreadPool();
+
+// Runs fn(0..count-1) on the calling thread and up to numThreads - 1 workers of pool. The
+// caller takes items too, so the loop completes even when every worker is busy (for
+// instance when it is called from a task of the same pool). Returns once every item ran.
+template <typename Fn>
+void parallelFor(ThreadPool& pool, int count, int numThreads, const Fn& fn) {
+    const int helpers = std::min({numThreads, count, pool.size() + 1}) - 1;
+    if (helpers <= 0) {
+        for (int i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    // Helpers that start after the last item was taken find nothing to do and never touch
+    // fn, so only the counters need to outlive this call
+    struct Progress {
+        std::atomic<int> next{0};
+        std::atomic<int> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto progress = std::make_shared<Progress>();
+    auto work = [progress, count, body = &fn] {
+        for (int i; (i = progress->next.fetch_add(1)) < count;) {
+            (*body)(i);
+            if (progress->done.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(progress->mutex);
+                progress->finished.notify_all();
+            }
+        }
+    };
+    for (int h = 0; h < helpers; ++h) pool.submit(work);
+    work();
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->finished.wait(lock, [&] { return progress->done.load() == count; });
+}
+
+/*
+ * Counting budget of bytes shared by concurrent tasks, used to bound the memory held by
+ * in-flight work. A request larger than the whole budget is granted once nothing else
+ * is in flight, so a single oversized item cannot deadlock the pool.
+ *
+ * */
+
+class MemoryBudget
+{
+   private:
+      std::size_t capacity;
+      std::size_t inUse;
+      std::mutex mutex;
+      std::condition_variable released;
+
+   public:
+      explicit MemoryBudget(std::size_t capacity);
+
+    // methods
+    void acquire(std::size_t bytes);   // block until bytes fit in the budget
+    void release(std::size_t bytes);   // return bytes to the budget
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "ThresholdKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define THRESHOLD_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+
+// Scalar byte mask, also used for the tails of the vector variants
+template <typename Sample>
+void byteMaskScalar(const Sample* src, unsigned char* dst, std::size_t count, Sample threshold) {
+    for (std::size_t i = 0; i < count; ++i) dst[i] = (src[i] >= threshold) ? 255 : 0;
+}
+
+// Scalar bit mask for count pixels starting at a word boundary
+template <typename Sample>
+void bitMaskScalar(const Sample* src, std::uint64_t* dst, std::size_t count, Sample threshold) {
+    for (std::size_t word = 0; word * 64 < count; ++word) {
+        std::size_t n = (count - word * 64 < 64) ? count - word * 64 : 64;
+        std::uint64_t bits = 0;
+        for (std::size_t b = 0; b < n; ++b) {
+            bits |= static_cast<std::uint64_t>(src[word * 64 + b] >= threshold) << b;
+        }
+        dst[word] = bits;
+    }
+}
+
+#ifdef THRESHOLD_KERNEL_X86
+
+// x >= t for unsigned bytes is max(x, t) == x, since SSE2 has no unsigned compare
+
+void byteMaskSse2(const unsigned char* src, unsigned char* dst, std::size_t count,
+                  unsigned char threshold) {
+    const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_cmpeq_epi8(_mm_max_epu8(x, t), x));
+    }
+    byteMaskScalar(src + i, dst + i, count - i, threshold);
+}
+
+void bitMaskSse2(const unsigned char* src, std::uint64_t* dst, std::size_t count,
+                 unsigned char threshold) {
+    const __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+    std::size_t word = 0;
+    for (; (word + 1) * 64 <= count; ++word) {
+        std::uint64_t bits = 0;
+        for (int part = 0; part < 4; ++part) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + word * 64 + part * 16));
+            std::uint64_t mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, t), x)));
+            bits |= mask << (part * 16);
+        }
+        dst[word] = bits;
+    }
+    bitMaskScalar(src + word * 64, dst + word, count - word * 64, threshold);
+}
+
+__attribute__((target("avx2")))
+void byteMaskAvx2(const unsigned char* src, unsigned char* dst, std::size_t count,
+                  unsigned char threshold) {
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(threshold));
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cmpeq_epi8(_mm256_max_epu8(x, t), x));
+    }
+    byteMaskScalar(src + i, dst + i, count - i, threshold);
+}
+
+__attribute__((target("avx2")))
+void bitMaskAvx2(const unsigned char* src, std::uint64_t* dst, std::size_t count,
+                 unsigned char threshold) {
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(threshold));
+    std::size_t word = 0;
+    for (; (word + 1) * 64 <= count; ++word) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + word * 64));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + word * 64 + 32));
+        std::uint64_t loBits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(lo, t), lo)));
+        std::uint64_t hiBits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(hi, t), hi)));
+        dst[word] = loBits | (hiBits << 32);
+    }
+    bitMaskScalar(src + word * 64, dst + word, count - word * 64, threshold);
+}
+
+// 16-bit samples: x >= t is (t -sat x) == 0, saturating subtraction standing in for the
+// unsigned compare. The 0xFFFF/0 lanes are narrowed to bytes with a signed pack.
+
+__m128i geMask16Sse2(const std::uint16_t* src, __m128i t) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    return _mm_cmpeq_epi16(_mm_subs_epu16(t, x), _mm_setzero_si128());
+}
+
+void byteMask16Sse2(const std::uint16_t* src, unsigned char* dst, std::size_t count, std::uint16_t threshold) {
+    const __m128i t = _mm_set1_epi16(static_cast<short>(threshold));
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i packed = _mm_packs_epi16(geMask16Sse2(src + i, t), geMask16Sse2(src + i + 8, t));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    byteMaskScalar(src + i, dst + i, count - i, threshold);
+}
+
+void bitMask16Sse2(const std::uint16_t* src, std::uint64_t* dst, std::size_t count, std::uint16_t threshold) {
+    const __m128i t = _mm_set1_epi16(static_cast<short>(threshold));
+    std::size_t word = 0;
+    for (; (word + 1) * 64 <= count; ++word) {
+        std::uint64_t bits = 0;
+        for (int part = 0; part < 4; ++part) {
+            const std::uint16_t* p = src + word * 64 + part * 16;
+            __m128i packed = _mm_packs_epi16(geMask16Sse2(p, t), geMask16Sse2(p + 8, t));
+            bits |= static_cast<std::uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(packed))) << (part * 16);
+        }
+        dst[word] = bits;
+    }
+    bitMaskScalar(src + word * 64, dst + word, count - word * 64, threshold);
+}
+
+__attribute__((target("avx2")))
+__m256i geMask16Avx2(const std::uint16_t* src, __m256i t) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    return _mm256_cmpeq_epi16(_mm256_subs_epu16(t, x), _mm256_setzero_si256());
+}
+
+// The AVX2 pack works per 128-bit lane, so the quadwords are put back in pixel order
+__attribute__((target("avx2")))
+__m256i pack16Avx2(const std::uint16_t* src, __m256i t) {
+    __m256i packed = _mm256_packs_epi16(geMask16Avx2(src, t), geMask16Avx2(src + 16, t));
+    return _mm256_permute4x64_epi64(packed, 0xD8);
+}
+
+__attribute__((target("avx2")))
+void byteMask16Avx2(const std::uint16_t* src, unsigned char* dst, std::size_t count, std::uint16_t threshold) {
+    const __m256i t = _mm256_set1_epi16(static_cast<short>(threshold));
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), pack16Avx2(src + i, t));
+    }
+    byteMaskScalar(src + i, dst + i, count - i, threshold);
+}
+
+__attribute__((target("avx2")))
+void bitMask16Avx2(const std::uint16_t* src, std::uint64_t* dst, std::size_t count, std::uint16_t threshold) {
+    const __m256i t = _mm256_set1_epi16(static_cast<short>(threshold));
+    std::size_t word = 0;
+    for (; (word + 1) * 64 <= count; ++word) {
+        std::uint64_t loBits = static_cast<std::uint32_t>(_mm256_movemask_epi8(pack16Avx2(src + word * 64, t)));
+        std::uint64_t hiBits = static_cast<std::uint32_t>(_mm256_movemask_epi8(pack16Avx2(src + word * 64 + 32, t)));
+        dst[word] = loBits | (hiBits << 32);
+    }
+    bitMaskScalar(src + word * 64, dst + word, count - word * 64, threshold);
+}
+
+// Float samples compare directly (NaN is never foreground, as in the scalar test)
+
+__m128i geMaskFloatSse2(const float* src, __m128 t) {
+    return _mm_castps_si128(_mm_cmpge_ps(_mm_loadu_ps(src), t));
+}
+
+void byteMaskFloatSse2(const float* src, unsigned char* dst, std::size_t count, float threshold) {
+    const __m128 t = _mm_set1_ps(threshold);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i lo = _mm_packs_epi32(geMaskFloatSse2(src + i, t), geMaskFloatSse2(src + i + 4, t));
+        __m128i hi = _mm_packs_epi32(geMaskFloatSse2(src + i + 8, t), geMaskFloatSse2(src + i + 12, t));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi16(lo, hi));
+    }
+    byteMaskScalar(src + i, dst + i, count - i, threshold);
+}
+
+void bitMaskFloatSse2(const float* src, std::uint64_t* dst, std::size_t count, float threshold) {
+    const __m128 t = _mm_set1_ps(threshold);
+    std::size_t word = 0;
+    for (; (word + 1) * 64 <= count; ++word) {
+        std::uint64_t bits = 0;
+        for (int part = 0; part < 16; ++part) {
+            unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(src + word * 64 + part * 4), t)));
+            bits |= static_cast<std::uint64_t>(mask) << (part * 4);
+        }
+        dst[word] = bits;
+    }
+    bitMaskScalar(src + word * 64, dst + word, count - word * 64, threshold);
+}
+
+__attribute__((target("avx2")))
+unsigned geBitsFloatAvx2(const float* src, __m256 t) {
+    return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(src), t, _CMP_GE_OQ)));
+}
+
+__attribute__((target("avx2")))
+void byteMaskFloatAvx2(const float* src, unsigned char* dst, std::size_t count, float threshold) {
+    const __m256 t = _mm256_set1_ps(threshold);
+    // Packing works per 128-bit lane; this restores the order of the 4-pixel groups
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i m[4];
+        for (int part = 0; part < 4; ++part) {
+            m[part] = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(src + i + part * 8), t, _CMP_GE_OQ));
+        }
+        __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(m[0], m[1]), _mm256_packs_epi32(m[2], m[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    byteMaskScalar(src + i, dst + i, count - i, threshold);
+}
+
+__attribute__((target("avx2")))
+void bitMaskFloatAvx2(const float* src, std::uint64_t* dst, std::size_t count, float threshold) {
+    const __m256 t = _mm256_set1_ps(threshold);
+    std::size_t word = 0;
+    for (; (word + 1) * 64 <= count; ++word) {
+        std::uint64_t bits = 0;
+        for (int part = 0; part < 8; ++part) {
+            bits |= static_cast<std::uint64_t>(geBitsFloatAvx2(src + word * 64 + part * 8, t)) << (part * 8);
+        }
+        dst[word] = bits;
+    }
+    bitMaskScalar(src + word * 64, dst + word, count - word * 64, threshold);
+}
+
+#endif
+
+// Every variant this CPU can run, scalar first and the preferred one last
+std::vector<ThresholdKernelSet> supportedSets() {
+    std::vector<ThresholdKernelSet> sets = {
+        {"scalar", byteMaskScalar<unsigned char>, bitMaskScalar<unsigned char>, byteMaskScalar<std::uint16_t>,
+         bitMaskScalar<std::uint16_t>, byteMaskScalar<float>, bitMaskScalar<float>}};
+#ifdef THRESHOLD_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        sets.push_back({"sse2", byteMaskSse2, bitMaskSse2, byteMask16Sse2, bitMask16Sse2,
+                        byteMaskFloatSse2, bitMaskFloatSse2});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        sets.push_back({"avx2", byteMaskAvx2, bitMaskAvx2, byteMask16Avx2, bitMask16Avx2,
+                        byteMaskFloatAvx2, bitMaskFloatAvx2});
+    }
+#endif
+    return sets;
+}
+
+// The kernels chosen for this CPU, resolved on first use
+const ThresholdKernelSet& kernels() {
+    static const ThresholdKernelSet selected = thresholdKernelSets().back();
+    return selected;
+}
+
+}
+
+// Lists the variants once, on first use.
+const std::vector<ThresholdKernelSet>& thresholdKernelSets() {
+    static const std::vector<ThresholdKernelSet> sets = supportedSets();
+    return sets;
+}
+
+// Byte mask threshold, dispatched to the best kernel for this CPU
+void thresholdToByteMask(const unsigned char* src, unsigned char* dst, std::size_t count,
+                         unsigned char threshold) {
+    kernels().byteMask8(src, dst, count, threshold);
+}
+
+// Bit mask threshold, dispatched to the best kernel for this CPU
+void thresholdToBitMask(const unsigned char* src, std::uint64_t* dst, std::size_t count,
+                        unsigned char threshold) {
+    kernels().bitMask8(src, dst, count, threshold);
+}
+
+// 16-bit byte mask threshold, dispatched to the best kernel for this CPU
+void thresholdToByteMask(const std::uint16_t* src, unsigned char* dst, std::size_t count,
+                         std::uint16_t threshold) {
+    kernels().byteMask16(src, dst, count, threshold);
+}
+
+// 16-bit bit mask threshold, dispatched to the best kernel for this CPU
+void thresholdToBitMask(const std::uint16_t* src, std::uint64_t* dst, std::size_t count,
+                        std::uint16_t threshold) {
+    kernels().bitMask16(src, dst, count, threshold);
+}
+
+// Float byte mask threshold, dispatched to the best kernel for this CPU
+void thresholdToByteMask(const float* src, unsigned char* dst, std::size_t count, float threshold) {
+    kernels().byteMaskFloat(src, dst, count, threshold);
+}
+
+// Float bit mask threshold, dispatched to the best kernel for this CPU
+void thresholdToBitMask(const float* src, std::uint64_t* dst, std::size_t count, float threshold) {
+    kernels().bitMaskFloat(src, dst, count, threshold);
+}
+
+// Returns the name of the selected kernel variant
+const char* thresholdKernelName() { return kernels().name; }
@@ -0,0 +1,51 @@
+#ifndef THRESHOLD_KERNEL_H
+#define THRESHOLD_KERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Vectorised binarisation kernels used by the processors before labeling.
+ * The SSE2 or AVX2 variant is picked once at runtime from the CPU features,
+ * with a portable scalar fallback on other machines.
+ *
+ * */
+
+// Writes 255 to dst[i] where src[i] >= threshold and 0 elsewhere
+void thresholdToByteMask(const unsigned char* src, unsigned char* dst, std::size_t count,
+                         unsigned char threshold);
+
+// Packs the same test into bits: bit (i % 64) of dst[i / 64] is set where src[i] >= threshold.
+// Writes (count + 63) / 64 words; bits past count in the last word are cleared.
+void thresholdToBitMask(const unsigned char* src, std::uint64_t* dst, std::size_t count,
+                        unsigned char threshold);
+
+// The same kernels for 16-bit and float samples, so deeper images are thresholded at full
+// precision; the selected variant is the same as for bytes
+void thresholdToByteMask(const std::uint16_t* src, unsigned char* dst, std::size_t count,
+                         std::uint16_t threshold);
+void thresholdToBitMask(const std::uint16_t* src, std::uint64_t* dst, std::size_t count,
+                        std::uint16_t threshold);
+void thresholdToByteMask(const float* src, unsigned char* dst, std::size_t count, float threshold);
+void thresholdToBitMask(const float* src, std::uint64_t* dst, std::size_t count, float threshold);
+
+// One complete variant of the kernels above
+struct ThresholdKernelSet {
+    const char* name;
+    void (*byteMask8)(const unsigned char*, unsigned char*, std::size_t, unsigned char);
+    void (*bitMask8)(const unsigned char*, std::uint64_t*, std::size_t, unsigned char);
+    void (*byteMask16)(const std::uint16_t*, unsigned char*, std::size_t, std::uint16_t);
+    void (*bitMask16)(const std::uint16_t*, std::uint64_t*, std::size_t, std::uint16_t);
+    void (*byteMaskFloat)(const float*, unsigned char*, std::size_t, float);
+    void (*bitMaskFloat)(const float*, std::uint64_t*, std::size_t, float);
+};
+
+// Every variant this CPU supports, scalar first and the dispatched one last, so tests and
+// benchmarks can run each of them directly
+const std::vector<ThresholdKernelSet>& thresholdKernelSets();
+
+// Name of the kernel variant selected for this CPU ("avx2", "sse2" or "scalar")
+const char* thresholdKernelName();
+
+#endif
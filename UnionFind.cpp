@@ -0,0 +1,78 @@
+#include "UnionFind.h"
+#include <utility>
+
+// Adds a new label that is only equivalent to itself and returns it.
+int UnionFind::makeSet() {
+    int label = static_cast<int>(parent.size());
+    parent.push_back(label);
+    rank.push_back(0);
+    return label;
+}
+
+// Returns the root of the set containing label, halving the path on the way up.
+int UnionFind::find(int label) {
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+// Merges the sets containing a and b; the shallower tree is hung below the deeper one.
+int UnionFind::unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return a;
+    if (rank[a] < rank[b]) std::swap(a, b);
+    parent[b] = a;
+    if (rank[a] == rank[b]) rank[a]++;
+    return a;
+}
+
+// Returns the number of labels created since the last clear.
+int UnionFind::size() const { return static_cast<int>(parent.size()); }
+
+// Reserves storage so that count labels can be created without reallocating.
+void UnionFind::reserve(int count) {
+    parent.reserve(count);
+    rank.reserve(count);
+}
+
+// Removes every label.
+void UnionFind::clear() {
+    parent.clear();
+    rank.clear();
+}
+
+// Creates count singleton sets labelled 0..count-1.
+ConcurrentUnionFind::ConcurrentUnionFind(int count) : parent(count) {
+    for (int i = 0; i < count; ++i) parent[i].store(i, std::memory_order_relaxed);
+}
+
+// Returns the root of label's set. Path halving is done with a CAS, so a lost race only
+// means a shortcut was not taken.
+int ConcurrentUnionFind::find(int label) {
+    while (true) {
+        int up = parent[label].load(std::memory_order_acquire);
+        if (up == label) return label;
+        int upUp = parent[up].load(std::memory_order_acquire);
+        if (up != upUp) parent[label].compare_exchange_weak(up, upUp, std::memory_order_acq_rel);
+        label = upUp;
+    }
+}
+
+// Merges the sets of a and b by hanging the larger root below the smaller one,
+// retrying when another thread re-parented the root in the meantime.
+void ConcurrentUnionFind::unite(int a, int b) {
+    while (true) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (a < b) std::swap(a, b);
+        int expected = a;
+        if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) return;
+    }
+}
+
+// Returns the number of labels.
+int ConcurrentUnionFind::size() const { return static_cast<int>(parent.size()); }
@@ -0,0 +1,54 @@
+#ifndef UNION_FIND_H
+#define UNION_FIND_H
+
+#include <vector>
+#include <atomic>
+
+/*
+ * Disjoint-set forest used as the label equivalence table of the two-pass labeler.
+ * Union by rank together with path compression keeps find/unite effectively O(1).
+ *
+ * */
+
+class UnionFind
+{
+   private:
+      std::vector<int> parent;          // parent label of each label (roots point to themselves)
+      std::vector<unsigned char> rank;  // upper bound on the height of each root's tree
+
+   public:
+      UnionFind() = default;
+      ~UnionFind() = default;
+
+    // methods
+    int makeSet();               // add a new singleton set and return its label
+    int find(int label);         // get the representative label of the set containing label
+    int unite(int a, int b);     // merge the sets of a and b, returns the surviving representative
+    int size() const;            // number of labels handed out so far
+    void reserve(int count);     // pre-allocate room for count labels
+    void clear();                // forget all labels
+};
+
+/*
+ * Lock-free disjoint-set forest over a fixed number of labels, used to merge labels
+ * across stripe seams from several threads at once. Roots are always linked below the
+ * smaller label, so the representative of a set is its smallest label.
+ *
+ * */
+
+class ConcurrentUnionFind
+{
+   private:
+      std::vector<std::atomic<int>> parent;  // parent label of each label (roots point to themselves)
+
+   public:
+      explicit ConcurrentUnionFind(int count);
+      ~ConcurrentUnionFind() = default;
+
+    // methods
+    int find(int label);          // get the representative label, safe to call concurrently
+    void unite(int a, int b);     // merge the sets of a and b, safe to call concurrently
+    int size() const;             // number of labels
+};
+
+#endif
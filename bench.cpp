@@ -0,0 +1,266 @@
+// bench.cpp
+// Microbenchmarks for the labeling pipeline. Each workload is timed phase by phase
+// (threshold, labeling, filter, write) and reported in ns/pixel and MB/s as JSON, so runs
+// from different releases can be diffed. Workloads are generated from fixed seeds.
+//
+//   ./runBench [--min-time seconds] [--size WxH] [--filter text] [--out file] [extra.pgm ...]
+
+#include "BitImage.h"
+#include "ComponentLabeler.h"
+#include "PGMimage.h"
+#include "PGMimageProcessor.h"
+#include "ThresholdKernel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// A grayscale test image and the threshold it is benchmarked at
+struct Workload {
+    std::string name;
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+    unsigned char threshold;
+};
+
+// One timed phase of one workload
+struct BenchResult {
+    std::string workload;
+    std::string phase;
+    long long pixels;
+    long long bytes;        // bytes of input the phase consumes per iteration
+    int iterations;
+    double meanNs;
+    double minNs;
+    int components;
+};
+
+// Random pixels, bright with probability density percent
+Workload makeNoise(int width, int height, int density) {
+    Workload w{"noise_" + std::to_string(density), width, height,
+               std::vector<unsigned char>(static_cast<size_t>(width) * height), 128};
+    std::mt19937 rng(1000 + density);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (auto& value : w.pixels) value = (percent(rng) < density) ? 255 : 0;
+    return w;
+}
+
+// A few hundred large filled discs
+Workload makeBlobs(int width, int height) {
+    Workload w{"blobs", width, height, std::vector<unsigned char>(static_cast<size_t>(width) * height, 0), 128};
+    std::mt19937 rng(77);
+    std::uniform_int_distribution<int> px(0, width - 1), py(0, height - 1), pr(8, std::max(9, width / 16));
+    for (int i = 0; i < 300; ++i) {
+        int cx = px(rng), cy = py(rng), r = pr(rng);
+        for (int y = std::max(0, cy - r); y <= std::min(height - 1, cy + r); ++y) {
+            for (int x = std::max(0, cx - r); x <= std::min(width - 1, cx + r); ++x) {
+                if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r) w.pixels[static_cast<size_t>(y) * width + x] = 200;
+            }
+        }
+    }
+    return w;
+}
+
+// One-pixel checkerboard: every foreground pixel is its own 4-connected component
+Workload makeCheckerboard(int width, int height) {
+    Workload w{"checkerboard", width, height, std::vector<unsigned char>(static_cast<size_t>(width) * height), 128};
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) w.pixels[static_cast<size_t>(y) * width + x] = ((x + y) % 2) ? 255 : 0;
+    }
+    return w;
+}
+
+// A single one-pixel-wide serpentine filling the image, the worst case for label merging
+Workload makeSerpentine(int width, int height) {
+    Workload w{"serpentine", width, height, std::vector<unsigned char>(static_cast<size_t>(width) * height, 0), 128};
+    for (int y = 0; y < height; y += 2) {
+        std::fill_n(w.pixels.begin() + static_cast<size_t>(y) * width, width, 255);
+        if (y + 1 < height) {
+            int x = ((y / 2) % 2 == 0) ? width - 1 : 0;
+            w.pixels[static_cast<size_t>(y + 1) * width + x] = 255;
+        }
+    }
+    return w;
+}
+
+// Loads a PGM from disk; returns false if it cannot be read
+bool loadWorkload(const std::string& fileName, unsigned char threshold, Workload& w) {
+    PGMimage image;
+    image.read(fileName);
+    const PGMimage& view = image;
+    if (view.getBuffer() == nullptr) return false;
+    image.getDims(w.width, w.height);
+    w.name = std::filesystem::path(fileName).stem().string();
+    w.pixels.assign(view.getBuffer(), view.getBuffer() + static_cast<size_t>(w.width) * w.height);
+    w.threshold = threshold;
+    return true;
+}
+
+// Times fn until minTime has elapsed (at least 3 runs); setup runs untimed before each call
+BenchResult timePhase(const std::string& workload, const std::string& phase, long long pixels,
+                      long long bytes, double minTime, const std::function<void()>& setup,
+                      const std::function<int()>& fn) {
+    using clock = std::chrono::steady_clock;
+    BenchResult result{workload, phase, pixels, bytes, 0, 0.0, 0.0, 0};
+    double total = 0.0, best = 1e300;
+    while (result.iterations < 3 || total < minTime * 1e9) {
+        if (setup) setup();
+        auto start = clock::now();
+        result.components = fn();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        total += ns;
+        best = std::min(best, ns);
+        result.iterations++;
+    }
+    result.meanNs = total / result.iterations;
+    result.minNs = best;
+    return result;
+}
+
+// Runs all four phases on one workload
+void benchWorkload(const Workload& w, double minTime, const std::string& scratchDir,
+                   std::vector<BenchResult>& results) {
+    const long long pixels = static_cast<long long>(w.width) * w.height;
+    std::cerr << "  " << w.name << " (" << w.width << "x" << w.height << ")" << std::endl;
+
+    BitImage mask(w.width, w.height);
+    results.push_back(timePhase(w.name, "threshold", pixels, pixels, minTime, nullptr, [&] {
+        mask.threshold(w.pixels.data(), w.threshold);
+        return 0;
+    }));
+    std::pmr::monotonic_buffer_resource arena;   // as in the processors, released after each run
+    results.push_back(timePhase(w.name, "labeling", pixels, static_cast<long long>(mask.memoryBytes()),
+                                minTime, nullptr, [&] {
+        int count = static_cast<int>(labelTwoPass(mask, 1, false, 1, nullptr, &arena).size());
+        arena.release();
+        return count;
+    }));
+    results.push_back(timePhase(w.name, "fused", pixels, pixels, minTime, nullptr, [&] {
+        int count = static_cast<int>(labelTwoPass(w.pixels.data(), w.width, w.height, w.threshold, 1, false, 1,
+                                                  nullptr, &arena).size());
+        arena.release();
+        return count;
+    }));
+
+    // Filtering and writing work on a processor's components; a fresh copy is made per run
+    const std::string input = scratchDir + "/" + w.name + ".pgm";
+    PGMimage image;
+    image.setImageData(const_cast<unsigned char*>(w.pixels.data()), w.width, w.height);
+    image.write(input);
+    PGMimageProcessor labelled(input);
+    labelled.extractComponents(w.threshold, 1);
+    int median = labelled.getSmallestSize() + (labelled.getLargestSize() - labelled.getSmallestSize()) / 2;
+
+    // Reference BFS engine, on a freshly loaded processor each run (loading is not timed)
+    ExtractionOptions bfsOptions;
+    bfsOptions.method = LabelingMethod::BFS;
+    std::unique_ptr<PGMimageProcessor> flooding;
+    results.push_back(timePhase(w.name, "bfs", pixels, pixels, minTime,
+                                [&] { flooding = std::make_unique<PGMimageProcessor>(input); }, [&] {
+        return flooding->extractComponents(w.threshold, 1, bfsOptions);
+    }));
+
+    PGMimageProcessor working = labelled;
+    results.push_back(timePhase(w.name, "filter", pixels, 0, minTime, [&] { working = labelled; }, [&] {
+        return working.filterComponentsBySize(median, labelled.getLargestSize());
+    }));
+    const std::string output = scratchDir + "/" + w.name + "_out.pgm";
+    results.push_back(timePhase(w.name, "write", pixels, pixels, minTime, nullptr, [&] {
+        labelled.writeComponents(output);
+        return labelled.getComponentCount();
+    }));
+}
+
+// Writes the results as a JSON document
+void writeJson(std::ostream& out, const std::vector<BenchResult>& results, double minTime) {
+    out << "{\n  \"context\": {\n"
+        << "    \"threshold_kernel\": \"" << thresholdKernelName() << "\",\n"
+        << "    \"min_time_s\": " << minTime << "\n  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double seconds = r.meanNs * 1e-9;
+        out << "    {\"name\": \"" << r.workload << "/" << r.phase << "\", \"workload\": \"" << r.workload
+            << "\", \"phase\": \"" << r.phase << "\", \"iterations\": " << r.iterations
+            << ", \"pixels\": " << r.pixels << ", \"mean_ns\": " << r.meanNs << ", \"min_ns\": " << r.minNs
+            << ", \"ns_per_pixel\": " << r.meanNs / r.pixels
+            << ", \"mb_per_s\": " << (seconds > 0 ? r.bytes / seconds / 1e6 : 0.0)
+            << ", \"components\": " << r.components << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    double minTime = 0.2;
+    int width = 2048, height = 2048;
+    std::string filter, outFile;
+    std::vector<std::string> extraFiles;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--min-time" && i+1 < argc) {
+            minTime = std::stod(argv[++i]);
+        } else if (arg == "--size" && i+1 < argc) {
+            std::string size = argv[++i];
+            width = std::stoi(size.substr(0, size.find('x')));
+            height = std::stoi(size.substr(size.find('x') + 1));
+        } else if (arg == "--filter" && i+1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--out" && i+1 < argc) {
+            outFile = argv[++i];
+        } else if (arg[0] != '-') {
+            extraFiles.push_back(arg);
+        }
+    }
+
+    std::vector<Workload> workloads;
+    for (int density : {10, 50, 90}) workloads.push_back(makeNoise(width, height, density));
+    workloads.push_back(makeBlobs(width, height));
+    workloads.push_back(makeCheckerboard(width, height));
+    workloads.push_back(makeSerpentine(width, height));
+
+    // The assignment images at their documented thresholds, when converted copies exist
+    const std::pair<const char*, unsigned char> resources[] = {
+        {"Assignment Resources/Birds.pgm", 35}, {"Assignment Resources/Shapes.pgm", 128},
+        {"Assignment Resources/Chess.pgm", 171}};
+    for (const auto& [file, threshold] : resources) {
+        Workload w;
+        if (std::filesystem::exists(file) && loadWorkload(file, threshold, w)) workloads.push_back(std::move(w));
+    }
+    for (const auto& file : extraFiles) {
+        Workload w;
+        if (loadWorkload(file, 128, w)) workloads.push_back(std::move(w));
+        else std::cerr << "Skipping unreadable benchmark input " << file << std::endl;
+    }
+
+    const std::string scratchDir = (std::filesystem::temp_directory_path() / "findcomp_bench").string();
+    std::filesystem::create_directories(scratchDir);
+
+    std::vector<BenchResult> results;
+    std::cerr << "Running benchmarks (threshold kernel: " << thresholdKernelName() << ")" << std::endl;
+    for (const auto& w : workloads) {
+        if (!filter.empty() && w.name.find(filter) == std::string::npos) continue;
+        benchWorkload(w, minTime, scratchDir, results);
+    }
+    std::filesystem::remove_all(scratchDir);
+
+    if (outFile.empty()) {
+        writeJson(std::cout, results, minTime);
+    } else {
+        std::ofstream out(outFile);
+        writeJson(out, results, minTime);
+    }
+    return 0;
+}
@@ -1,13 +1,39 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <fstream>
 #include "PGMimageProcessor.h"
+#include "StreamingExtractor.h"
+#include "BatchRunner.h"
 #include <algorithm>
 
+// Prints the statistics and/or writes them as JSON, as requested. Returns false if the JSON
+// file cannot be written.
+static bool reportStats(const ProcessingStats& stats, bool show, const std::string& statsFile) {
+    if (show) {
+        stats.print(std::cout);
+    }
+    if (!statsFile.empty()) {
+        std::ofstream statsOut(statsFile);
+        if (!statsOut) {
+            std::cerr << "Unable to write statistics to " << statsFile << std::endl;
+            return false;
+        }
+        stats.writeJson(statsOut);
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     // Input/output file names and parameters with default values
-    std::string inputFile, outFileName;
+    std::string inputFile, outFileName, labelFileName, exportFileName, outputDir, summaryFile;
+    std::vector<std::string> batchSpecs;
+    long long memoryBudgetMB = 1024;
+    bool showStats = false;
+    std::string statsFile, sweepFile;
     int threshold = 128, minValid = 1, filterMin = -1, filterMax = -1;
-    bool print = false;
+    bool print = false, stream = false;
+    ExtractionOptions options;
 
     // Parse command-line arguments
     for (int i = 1; i < argc; ++i) {
@@ -26,27 +52,192 @@ int main(int argc, char* argv[]) {
         } else if (arg == "-p") {
             // Flag to print component information
             print = true;
+        } else if (arg == "-j" && i+1 < argc) {
+            // Worker threads for the two-pass labeler (defaults to all hardware threads)
+            options.numThreads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-b") {
+            // Use the BFS reference labeler instead of the two-pass engine
+            options.method = LabelingMethod::BFS;
+        } else if (arg == "-c" && i+1 < argc) {
+            // Connectivity: 4 (edge neighbours, default) or 8 (edge and diagonal neighbours)
+            int neighbours = std::stoi(argv[++i]);
+            if (neighbours != 4 && neighbours != 8) {
+                std::cerr << "Connectivity must be 4 or 8, not " << neighbours << "." << std::endl;
+                return 1;
+            }
+            options.connectivity = (neighbours == 8) ? Connectivity::Eight : Connectivity::Four;
+        } else if (arg == "--maxtree") {
+            // Read components from a component tree of the image instead of labeling
+            options.method = LabelingMethod::MaxTree;
+        } else if (arg == "-s") {
+            // Stream the image in row bands instead of loading it whole
+            stream = true;
+        } else if (arg == "--batch" && i+1 < argc) {
+            // Batch input: directory, wildcard pattern or manifest file (may be repeated)
+            batchSpecs.push_back(argv[++i]);
+        } else if (arg == "-o" && i+1 < argc) {
+            // Batch mode output directory for the per-image component images
+            outputDir = argv[++i];
+        } else if (arg == "--summary" && i+1 < argc) {
+            // Batch mode summary CSV (printed to stdout when omitted)
+            summaryFile = argv[++i];
+        } else if (arg == "--mem" && i+1 < argc) {
+            // Batch mode budget, in MB, for the image data of images in flight
+            memoryBudgetMB = std::max(1LL, std::stoll(argv[++i]));
+        } else if (arg == "--stats") {
+            // Print per-phase timings and counters
+            showStats = true;
+        } else if (arg == "--stats-json" && i+1 < argc) {
+            // Dump per-phase timings and counters as JSON
+            statsFile = argv[++i];
+        } else if (arg == "--sweep" && i+1 < argc) {
+            // Write component counts for every threshold to a CSV file ("-" for stdout)
+            sweepFile = argv[++i];
         } else if (arg == "-w" && i+1 < argc) {
             // Output file name to write extracted components
             outFileName = argv[++i];
+        } else if (arg == "-l" && i+1 < argc) {
+            // Label map of component numbers: 16-bit PGM for .pgm names, raw 32-bit otherwise
+            labelFileName = argv[++i];
+        } else if (arg == "--export" && i+1 < argc) {
+            // Component records: .csv or "-" (stdout) for CSV, .json for JSON, binary otherwise
+            exportFileName = argv[++i];
         } else if (arg[0] != '-') {
-            // Positional argument assumed to be input file name
+            // Positional argument assumed to be input file name; several of them form a batch
+            if (!inputFile.empty()) batchSpecs.push_back(inputFile);
             inputFile = arg;
         }
     }
 
+    // Batch mode: every input goes through one shared worker pool in this process
+    if (!batchSpecs.empty()) {
+        if (!inputFile.empty()) batchSpecs.push_back(inputFile);
+        if (!outFileName.empty()) {
+            std::cerr << "Warning: -w is not supported in batch mode, use -o for the component images." << std::endl;
+        }
+        if (print) {
+            std::cerr << "Warning: -p is not supported in batch mode, see the summary for per-image counts." << std::endl;
+        }
+        if (showStats || !statsFile.empty()) {
+            std::cerr << "Warning: --stats and --stats-json are not supported in batch mode, no statistics will be reported." << std::endl;
+        }
+        if (!labelFileName.empty()) {
+            std::cerr << "Warning: -l is not supported in batch mode, no label maps will be written." << std::endl;
+        }
+        if (!exportFileName.empty()) {
+            std::cerr << "Warning: --export is not supported in batch mode, no component data will be written." << std::endl;
+        }
+        if (!sweepFile.empty()) {
+            std::cerr << "Warning: --sweep is not supported in batch mode, no threshold sweep will be written." << std::endl;
+        }
+        std::vector<std::string> inputs;
+        for (const auto& spec : batchSpecs) {
+            auto expanded = collectBatchInputs(spec);
+            inputs.insert(inputs.end(), expanded.begin(), expanded.end());
+        }
+        if (inputs.empty()) {
+            std::cerr << "No input files found for batch." << std::endl;
+            return 1;
+        }
+        BatchOptions batch;
+        batch.threshold = threshold;
+        batch.minValidSize = minValid;
+        batch.filterMin = filterMin;
+        batch.filterMax = filterMax;
+        batch.outputDir = outputDir;
+        batch.numThreads = options.numThreads;
+        batch.memoryBudget = static_cast<std::size_t>(memoryBudgetMB) << 20;
+        batch.extraction = options;
+        auto results = runBatch(inputs, batch);
+        if (!writeBatchSummary(summaryFile, results)) {
+            std::cerr << "Unable to write batch summary " << summaryFile << std::endl;
+            return 1;
+        }
+        bool allOk = std::all_of(results.begin(), results.end(), [](const BatchResult& r) { return r.ok; });
+        return allOk ? 0 : 1;
+    }
+
     // Check if input file was provided
     if (inputFile.empty()) {
         std::cerr << "No input file specified." << std::endl;
         return 1;
     }
 
+    // Streaming mode: components are summarised as they complete, no pixels are kept
+    if (stream) {
+        if (!outFileName.empty()) {
+            std::cerr << "Warning: -w is not supported with -s, no image will be written." << std::endl;
+        }
+        if (!labelFileName.empty()) {
+            std::cerr << "Warning: -l is not supported with -s, no label map will be written." << std::endl;
+        }
+        if (showStats || !statsFile.empty()) {
+            std::cerr << "Warning: --stats and --stats-json are not supported with -s, no statistics will be reported." << std::endl;
+        }
+        if (!exportFileName.empty()) {
+            std::cerr << "Warning: --export is not supported with -s, no component data will be written." << std::endl;
+        }
+        if (!sweepFile.empty()) {
+            std::cerr << "Warning: --sweep is not supported with -s, no threshold sweep will be written." << std::endl;
+        }
+        bool filter = filterMin != -1 && filterMax != -1;
+        long long largest = 0, smallest = 0;
+        int count = 0;
+        StreamingExtractor extractor(inputFile, 64, options.connectivity);
+        int found = extractor.extract(threshold, minValid, [&](int id, const ComponentStats& stats) {
+            if (filter && (stats.area < filterMin || stats.area > filterMax)) return;
+            largest = (count == 0) ? stats.area : std::max(largest, stats.area);
+            smallest = (count == 0) ? stats.area : std::min(smallest, stats.area);
+            count++;
+            if (print) {
+                std::cout << "Component ID: " << id << ", Number of pixels: " << stats.area
+                          << ", Box: (" << stats.minX << "," << stats.minY << ")-(" << stats.maxX
+                          << "," << stats.maxY << "), Centroid: (" << stats.centroidX() << ","
+                          << stats.centroidY() << ")\n";
+            }
+        });
+        if (found < 0) {
+            std::cerr << "Error: Failed to read image" << std::endl;
+            return 1;
+        }
+        if (print) {
+            std::cout << "Total components: " << count << std::endl;
+            std::cout << "Largest component size: " << largest << std::endl;
+            std::cout << "Smallest component size: " << smallest << std::endl;
+        }
+        return 0;
+    }
+
     try {
         // Create processor object and load image
         PGMimageProcessor processor(inputFile);
 
+        // Sweep mode: one component tree gives the results for all thresholds
+        if (!sweepFile.empty()) {
+            if (!outFileName.empty()) {
+                std::cerr << "Warning: -w is not supported with --sweep, no image will be written." << std::endl;
+            }
+            if (print) {
+                std::cerr << "Warning: -p is not supported with --sweep, see the sweep for per-threshold counts." << std::endl;
+            }
+            if (!labelFileName.empty()) {
+                std::cerr << "Warning: -l is not supported with --sweep, no label map will be written." << std::endl;
+            }
+            if (!exportFileName.empty()) {
+                std::cerr << "Warning: --export is not supported with --sweep, no component data will be written." << std::endl;
+            }
+            if (filterMin != -1 && filterMax != -1) {
+                std::cerr << "Warning: -f is not supported with --sweep, the counts are not filtered by size." << std::endl;
+            }
+            if (!writeThresholdSweep(sweepFile, processor.sweepThresholds(minValid, {}, options.connectivity))) {
+                std::cerr << "Unable to write threshold sweep to " << sweepFile << std::endl;
+                return 1;
+            }
+            return reportStats(processor.getStats(), showStats, statsFile) ? 0 : 1;
+        }
+
         // Extract connected components using threshold and minimum size
-        int count = processor.extractComponents(threshold, minValid);
+        int count = processor.extractComponents(threshold, minValid, options);
 
         // If size filtering is enabled, apply it
         if (filterMin != -1 && filterMax != -1) {
@@ -67,6 +258,19 @@ int main(int argc, char* argv[]) {
         if (!outFileName.empty()) {
             processor.writeComponents(outFileName);
         }
+        if (!labelFileName.empty() && !processor.writeLabelMap(labelFileName, labelMapFormatFor(labelFileName))) {
+            return 1;
+        }
+        if (!exportFileName.empty() &&
+            !processor.writeComponentData(exportFileName, componentDataFormatFor(exportFileName))) {
+            std::cerr << "Unable to write component data to " << exportFileName << std::endl;
+            return 1;
+        }
+
+        // Report where the time went (if requested)
+        if (!reportStats(processor.getStats(), showStats, statsFile)) {
+            return 1;
+        }
     } catch (const std::exception& e) {
         // Handle any errors thrown during processing
         std::cerr << "Error: " << e.what() << std::endl;
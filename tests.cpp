@@ -3,7 +3,69 @@
 #include "catch.hpp"
 #include "PGMimageProcessor.h"
 #include "ConnectedComponent.h"
+#include "UnionFind.h"
+#include "ThresholdKernel.h"
+#include "BitImage.h"
+#include "StreamingExtractor.h"
+#include "BatchRunner.h"
+#include "ThreadPool.h"
+#include "ComponentFilter.h"
+#include "ComponentLabeler.h"
+#include "PGMimage.h"
+#include "MaxTree.h"
+#include "PaddedMask.h"
+#include "ImageFormat.h"
+#include "ImageProcessor.h"
+#include "ColourKernel.h"
+#include "OverlayWriter.h"
+#include "LabelMap.h"
+#include "ComponentExport.h"
 #include <memory>
+#include <numbers>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <utility>
+#include <tuple>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <filesystem>
+#include <sstream>
+#include <set>
+#include <array>
+#include <bit>
+#include <memory_resource>
+#include <cmath>
+
+// Every fixture and output file lives under one scratch directory in the system's temp
+// directory, never in the working tree
+static std::string testFile(const std::string& name) {
+    static const std::filesystem::path root = [] {
+        auto dir = std::filesystem::temp_directory_path() / "findcomp_tests";
+        std::filesystem::create_directories(dir);
+        return dir;
+    }();
+    return (root / name).string();
+}
+
+// Writes a pseudo-random test image where roughly density percent of the pixels are bright
+static void writeNoiseImage(const std::string& fileName, int width, int height, int density, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<unsigned char> data(width * height);
+    for (auto& value : data) value = (percent(rng) < density) ? 200 : 20;
+    PGMimage noise;
+    noise.setImageData(data.data(), width, height);
+    noise.write(fileName);
+}
+
+// Returns the sorted pixel coordinates of a component
+static std::vector<std::pair<int, int>> sortedPixels(const ConnectedComponent& component) {
+    std::vector<std::pair<int, int>> pixels(component.getPixels().begin(), component.getPixels().end());
+    std::sort(pixels.begin(), pixels.end());
+    return pixels;
+}
 
 // Test ConnectedComponent class
 TEST_CASE("ConnectedComponent operations", "[component]") {
@@ -49,10 +111,10 @@ TEST_CASE("PGMimageProcessor operations", "[processor]") {
     // Create a test PGM file
     PGMimage testPGM;
     testPGM.setImageData(testImage, width, height);
-    testPGM.write("test_image.pgm");
+    testPGM.write(testFile("test_image.pgm"));
     
     // Test the image processor
-    PGMimageProcessor processor("test_image.pgm");
+    PGMimageProcessor processor(testFile("test_image.pgm"));
     
     SECTION("Extract components with threshold 100") {
         int count = processor.extractComponents(100, 1);
@@ -75,8 +137,1634 @@ TEST_CASE("PGMimageProcessor operations", "[processor]") {
     
     SECTION("Write components") {
         processor.extractComponents(100, 1);
-        bool success = processor.writeComponents("output_test.pgm");
+        bool success = processor.writeComponents(testFile("output_test.pgm"));
         REQUIRE(success);
         
     }
+}
+
+// Test the union-find equivalence table
+TEST_CASE("UnionFind operations", "[unionfind]") {
+    UnionFind sets;
+    for (int i = 0; i < 6; ++i) REQUIRE(sets.makeSet() == i);
+
+    sets.unite(0, 1);
+    sets.unite(2, 3);
+    sets.unite(1, 3);
+    REQUIRE(sets.find(0) == sets.find(2));
+    REQUIRE(sets.find(4) != sets.find(5));
+    REQUIRE(sets.find(4) != sets.find(0));
+    REQUIRE(sets.size() == 6);
+}
+
+// The two-pass engine must reproduce the BFS reference component for component
+TEST_CASE("Two-pass labeling matches BFS", "[labeling]") {
+    const int density = GENERATE(20, 50, 70);
+    writeNoiseImage(testFile("noise_image.pgm"), 97, 61, density, 1234 + density);
+
+    PGMimageProcessor bfsProcessor(testFile("noise_image.pgm"));
+    PGMimageProcessor twoPassProcessor(testFile("noise_image.pgm"));
+    ExtractionOptions bfsOptions;
+    bfsOptions.method = LabelingMethod::BFS;
+    int bfsCount = bfsProcessor.extractComponents(100, 3, bfsOptions);
+    int twoPassCount = twoPassProcessor.extractComponents(100, 3);
+
+    REQUIRE(bfsCount > 0);
+    REQUIRE(twoPassCount == bfsCount);
+    const auto& expected = bfsProcessor.getComponents();
+    const auto& actual = twoPassProcessor.getComponents();
+    for (int i = 0; i < bfsCount; ++i) {
+        REQUIRE(actual[i]->getId() == expected[i]->getId());
+        REQUIRE(actual[i]->getNumPixels() == expected[i]->getNumPixels());
+        REQUIRE(sortedPixels(*actual[i]) == sortedPixels(*expected[i]));
+    }
+}
+
+// Components store their pixels as runs and expand them on demand
+TEST_CASE("ConnectedComponent run storage", "[component]") {
+    ConnectedComponent component(7);
+
+    SECTION("Adjacent pixels on a row merge into one run") {
+        component.addPixel(2, 5);
+        component.addPixel(3, 5);
+        component.addPixel(4, 5);
+        component.addPixel(4, 6);
+        REQUIRE(component.getNumPixels() == 4);
+        REQUIRE(component.getRuns().size() == 2);
+        REQUIRE(component.getRuns()[0].xEnd == 4);
+    }
+
+    SECTION("Runs expand to pixels in order") {
+        component.addRun(1, 3, 5);
+        component.addRun(2, 0, 0);
+        REQUIRE(component.getNumPixels() == 4);
+
+        std::vector<std::pair<int, int>> walked(component.pixels().begin(), component.pixels().end());
+        std::vector<std::pair<int, int>> expected = {{3, 1}, {4, 1}, {5, 1}, {0, 2}};
+        REQUIRE(walked == expected);
+        REQUIRE(component.getPixels() == expected);
+    }
+
+    SECTION("Two-pass labeling emits one run per row of a solid block") {
+        unsigned char block[6 * 4] = {
+            0, 0, 0, 0, 0, 0,
+            0, 200, 200, 200, 200, 0,
+            0, 200, 200, 200, 200, 0,
+            0, 200, 200, 200, 200, 0
+        };
+        PGMimage blockImage;
+        blockImage.setImageData(block, 6, 4);
+        blockImage.write(testFile("block_image.pgm"));
+
+        PGMimageProcessor processor(testFile("block_image.pgm"));
+        REQUIRE(processor.extractComponents(100, 1) == 1);
+        REQUIRE(processor.getComponents()[0]->getNumPixels() == 12);
+        REQUIRE(processor.getComponents()[0]->getRuns().size() == 3);
+    }
+}
+
+// Stripe-parallel labeling must give the same components and ids as the serial run
+TEST_CASE("Parallel two-pass labeling matches serial", "[labeling][parallel]") {
+    const int density = GENERATE(30, 55, 80);
+    writeNoiseImage(testFile("noise_tall.pgm"), 83, 211, density, 99 + density);
+
+    PGMimageProcessor serialProcessor(testFile("noise_tall.pgm"));
+    PGMimageProcessor parallelProcessor(testFile("noise_tall.pgm"));
+    ExtractionOptions serialOptions, parallelOptions;
+    serialOptions.numThreads = 1;
+    parallelOptions.numThreads = 5;
+    int serialCount = serialProcessor.extractComponents(100, 1, serialOptions);
+    int parallelCount = parallelProcessor.extractComponents(100, 1, parallelOptions);
+
+    REQUIRE(parallelCount == serialCount);
+    const auto& expected = serialProcessor.getComponents();
+    const auto& actual = parallelProcessor.getComponents();
+    for (int i = 0; i < serialCount; ++i) {
+        REQUIRE(actual[i]->getId() == expected[i]->getId());
+        REQUIRE(actual[i]->getNumPixels() == expected[i]->getNumPixels());
+        REQUIRE(sortedPixels(*actual[i]) == sortedPixels(*expected[i]));
+    }
+}
+
+// Data-parallel loops run on a persistent pool: every item once, no new threads per call
+TEST_CASE("Parallel loops on a shared pool", "[parallel]") {
+    ThreadPool pool(3);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    for (int call = 0; call < 40; ++call) {
+        const int count = call % 9;
+        std::vector<std::atomic<int>> hits(count);
+        parallelFor(pool, count, 4, [&](int i) {
+            hits[i]++;
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        });
+        for (const auto& hit : hits) REQUIRE(hit == 1);
+    }
+    REQUIRE(threads.size() <= 4);   // the pool's three workers and the caller
+
+    // A loop started from one of the pool's own tasks still completes
+    std::atomic<int> nested{0};
+    pool.submit([&] { parallelFor(pool, 20, 4, [&](int) { nested++; }); });
+    pool.wait();
+    REQUIRE(nested == 20);
+}
+
+// The dispatched threshold kernels must agree with the scalar definition, tails included
+TEST_CASE("Threshold kernels", "[threshold]") {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+    const std::size_t count = GENERATE(0, 1, 15, 16, 63, 64, 65, 200, 1031);
+    const int threshold = GENERATE(0, 1, 128, 255);
+    std::vector<unsigned char> src(count);
+    for (auto& value : src) value = static_cast<unsigned char>(byte(rng));
+
+    std::vector<unsigned char> bytes(count, 17);
+    thresholdToByteMask(src.data(), bytes.data(), count, threshold);
+    std::vector<std::uint64_t> bits((count + 63) / 64, ~0ULL);
+    thresholdToBitMask(src.data(), bits.data(), count, threshold);
+
+    INFO("kernel " << thresholdKernelName());
+    for (std::size_t i = 0; i < count; ++i) {
+        bool on = src[i] >= threshold;
+        REQUIRE(bytes[i] == (on ? 255 : 0));
+        REQUIRE(((bits[i / 64] >> (i % 64)) & 1) == (on ? 1u : 0u));
+    }
+    if (count % 64 != 0) REQUIRE((bits.back() >> (count % 64)) == 0);
+}
+
+// Each variant the CPU supports, not just the dispatched one, against the plain comparison;
+// widths around the 16/32-sample vector steps and the 64-bit words exercise every tail
+TEST_CASE("Threshold kernel variants", "[threshold]") {
+    const auto& sets = thresholdKernelSets();
+    REQUIRE(std::string(sets.front().name) == "scalar");
+    REQUIRE(std::string(sets.back().name) == thresholdKernelName());
+
+    std::mt19937 rng(19);
+    std::uniform_int_distribution<int> word(0, 65535);
+    for (const ThresholdKernelSet& set : sets) {
+        for (std::size_t count : {0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 95, 127, 129, 200, 1031}) {
+            std::vector<unsigned char> bytes(count);
+            std::vector<std::uint16_t> words(count);
+            std::vector<float> floats(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                words[i] = static_cast<std::uint16_t>(word(rng));
+                bytes[i] = static_cast<unsigned char>(words[i] >> 8);
+                floats[i] = (i % 13 == 4) ? std::nanf("") : words[i] / 3.0f;
+            }
+            const int threshold = word(rng);
+            const unsigned char byteThreshold = static_cast<unsigned char>(threshold >> 8);
+            const float floatThreshold = threshold / 3.0f;
+
+            std::vector<unsigned char> byteOut(count, 17), wordOut(count, 17), floatOut(count, 17);
+            std::vector<std::uint64_t> byteBits((count + 63) / 64, ~0ULL), wordBits(byteBits), floatBits(byteBits);
+            set.byteMask8(bytes.data(), byteOut.data(), count, byteThreshold);
+            set.bitMask8(bytes.data(), byteBits.data(), count, byteThreshold);
+            set.byteMask16(words.data(), wordOut.data(), count, static_cast<std::uint16_t>(threshold));
+            set.bitMask16(words.data(), wordBits.data(), count, static_cast<std::uint16_t>(threshold));
+            set.byteMaskFloat(floats.data(), floatOut.data(), count, floatThreshold);
+            set.bitMaskFloat(floats.data(), floatBits.data(), count, floatThreshold);
+
+            INFO("kernel " << set.name << ", count " << count);
+            for (std::size_t i = 0; i < count; ++i) {
+                const bool byteOn = bytes[i] >= byteThreshold;
+                const bool wordOn = words[i] >= threshold;
+                const bool floatOn = floats[i] >= floatThreshold;
+                REQUIRE(byteOut[i] == (byteOn ? 255 : 0));
+                REQUIRE(wordOut[i] == (wordOn ? 255 : 0));
+                REQUIRE(floatOut[i] == (floatOn ? 255 : 0));
+                REQUIRE(((byteBits[i / 64] >> (i % 64)) & 1) == (byteOn ? 1u : 0u));
+                REQUIRE(((wordBits[i / 64] >> (i % 64)) & 1) == (wordOn ? 1u : 0u));
+                REQUIRE(((floatBits[i / 64] >> (i % 64)) & 1) == (floatOn ? 1u : 0u));
+            }
+            if (count % 64 != 0) {
+                REQUIRE((byteBits.back() >> (count % 64)) == 0);
+                REQUIRE((wordBits.back() >> (count % 64)) == 0);
+                REQUIRE((floatBits.back() >> (count % 64)) == 0);
+            }
+        }
+    }
+}
+
+// Bit-packed masks and their word-level run scanning
+TEST_CASE("BitImage operations", "[bitimage]") {
+    BitImage mask(130, 3);
+
+    SECTION("Rows are padded and start cleared") {
+        REQUIRE(mask.getStride() == 4);
+        REQUIRE(mask.memoryBytes() == 3 * 4 * sizeof(std::uint64_t));
+        REQUIRE(mask.countSet() == 0);
+        for (int y = 0; y < 3; ++y) REQUIRE(reinterpret_cast<std::uintptr_t>(mask.row(y)) % 32 == 0);
+        BitImage copy = mask;
+        REQUIRE(reinterpret_cast<std::uintptr_t>(copy.row(1)) % 32 == 0);
+    }
+
+    SECTION("Runs are found across word boundaries") {
+        for (int x : {0, 1, 2, 60, 61, 62, 63, 64, 65, 100, 127, 128, 129}) mask.set(x, 1, true);
+        mask.set(101, 1, true);
+        mask.set(101, 1, false);
+        REQUIRE(mask.get(64, 1));
+        REQUIRE_FALSE(mask.get(101, 1));
+        REQUIRE(mask.countSet() == 13);
+
+        std::vector<std::pair<int, int>> runs;
+        mask.forEachRun(1, [&](int xStart, int xEnd) { runs.emplace_back(xStart, xEnd); });
+        std::vector<std::pair<int, int>> expected = {{0, 2}, {60, 65}, {100, 100}, {127, 129}};
+        REQUIRE(runs == expected);
+    }
+
+    SECTION("A full row is a single run") {
+        std::vector<unsigned char> gray(130 * 3, 0);
+        std::fill(gray.begin() + 130 * 2, gray.end(), 255);
+        mask.threshold(gray.data(), 128);
+        std::vector<std::pair<int, int>> runs;
+        mask.forEachRun(2, [&](int xStart, int xEnd) { runs.emplace_back(xStart, xEnd); });
+        REQUIRE(runs == std::vector<std::pair<int, int>>{{0, 129}});
+        REQUIRE(mask.countSet() == 130);
+    }
+}
+
+// Mapped reads must see the same raster as copying reads, without owning a buffer
+TEST_CASE("PGMimage memory-mapped read", "[pgmimage]") {
+    const char header[] = "P5\n# comment line\n# another\n4 3\n255\n";
+    const unsigned char raster[12] = {0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 200, 255};
+    {
+        std::ofstream ofs(testFile("mapped_test.pgm"), std::ios::binary);
+        ofs.write(header, sizeof(header) - 1);
+        ofs.write(reinterpret_cast<const char*>(raster), sizeof(raster));
+    }
+
+    PGMimage copied, mapped;
+    copied.read(testFile("mapped_test.pgm"));
+    mapped.read(testFile("mapped_test.pgm"), PGMimage::ReadMode::Map);
+    REQUIRE_FALSE(copied.isMapped());
+    REQUIRE(mapped.isMapped());
+
+    int width = 0, height = 0;
+    mapped.getDims(width, height);
+    REQUIRE(width == 4);
+    REQUIRE(height == 3);
+    const PGMimage& view = mapped;
+    REQUIRE(std::equal(raster, raster + 12, view.getBuffer()));
+    REQUIRE(std::equal(raster, raster + 12, std::as_const(copied).getBuffer()));
+
+    SECTION("Copies share the mapping") {
+        PGMimage copy(mapped);
+        REQUIRE(copy.isMapped());
+        REQUIRE(std::as_const(copy).getBuffer() == view.getBuffer());
+    }
+
+    SECTION("Writable access detaches from the file") {
+        unsigned char* writable = mapped.getBuffer();
+        writable[0] = 99;
+        REQUIRE_FALSE(mapped.isMapped());
+        REQUIRE(view.getBuffer()[0] == 99);
+        PGMimage reread;
+        reread.read(testFile("mapped_test.pgm"), PGMimage::ReadMode::Map);
+        REQUIRE(std::as_const(reread).getBuffer()[0] == 0);
+    }
+
+    SECTION("Processors give the same result from either read mode") {
+        PGMimageProcessor fromMap(testFile("mapped_test.pgm"));
+        PGMimageProcessor fromCopy(testFile("mapped_test.pgm"), PGMimage::ReadMode::Copy);
+        REQUIRE(fromMap.extractComponents(45, 1) == fromCopy.extractComponents(45, 1));
+        REQUIRE(fromMap.getLargestSize() == 7);
+    }
+}
+
+// Writes a file byte for byte
+static void writeBytes(const std::string& fileName, const std::string& bytes) {
+    std::ofstream ofs(fileName, std::ios::binary);
+    ofs.write(bytes.data(), bytes.size());
+}
+
+// Every registered Netpbm variant reads to the same pixels
+TEST_CASE("Image format registry", "[format]") {
+    SECTION("Sniffing and headers") {
+        for (char magic : {'2', '3', '5', '6'}) {
+            const unsigned char bytes[] = {'P', static_cast<unsigned char>(magic)};
+            REQUIRE(findImageFormat(bytes, 2) != nullptr);
+            REQUIRE(findImageFormat(bytes, 2)->magic == magic);
+        }
+        const unsigned char bitmap[] = {'P', '4'};
+        REQUIRE(findImageFormat(bitmap, 2) == nullptr);
+
+        const std::string text = "P6 #size next\n 7\t5\n# maxval\n65535\nXY";
+        ImageHeader header;
+        REQUIRE(parseImageHeader(reinterpret_cast<const unsigned char*>(text.data()), text.size(), header));
+        REQUIRE(header.width == 7);
+        REQUIRE(header.height == 5);
+        REQUIRE(header.maxval == 65535);
+        REQUIRE(header.channels() == 3);
+        REQUIRE(header.bytesPerSample() == 2);
+        REQUIRE(text[header.rasterOffset] == 'X');
+
+        for (const std::string bad : {"P5\n7 5\n0\n", "P5\n7 5\n65536\n", "P5\n0 5\n255\n", "P5\n7 5\n255", "P5 7 x 255\n"}) {
+            REQUIRE_FALSE(parseImageHeader(reinterpret_cast<const unsigned char*>(bad.data()), bad.size(), header));
+        }
+    }
+
+    // The same 3x2 gray image in every variant; 16-bit and maxval 15 samples scale to these values
+    const unsigned char expected[6] = {0, 17, 34, 136, 238, 255};
+    std::string binary16, rgb8;
+    for (unsigned char v : expected) {
+        binary16 += static_cast<char>(v);   // v * 257 scales back to v exactly
+        binary16 += static_cast<char>(v);
+        rgb8 += std::string(3, static_cast<char>(v));
+    }
+    writeBytes(testFile("format_p2.pgm"), "P2\n# ascii\n3 2\n15\n0 1 2\n 8 14\n# inline\n15\n");
+    writeBytes(testFile("format_p5.pgm"), "P5\n3 2\n65535\n" + binary16);
+    writeBytes(testFile("format_p3.ppm"), "P3\n3 2\n255\n0 0 0 17 17 17 34 34 34 136 136 136 238 238 238 255 255 255\n");
+    writeBytes(testFile("format_p6.ppm"), "P6\n3 2\n255\n" + rgb8);
+
+    SECTION("PGMimage reads every variant") {
+        for (const std::string& name : {testFile("format_p2.pgm"), testFile("format_p5.pgm"), testFile("format_p3.ppm"), testFile("format_p6.ppm")}) {
+            for (auto mode : {PGMimage::ReadMode::Copy, PGMimage::ReadMode::Map}) {
+                PGMimage image;
+                image.read(name, mode);
+                int width = 0, height = 0;
+                image.getDims(width, height);
+                REQUIRE(width == 3);
+                REQUIRE(height == 2);
+                REQUIRE(std::equal(expected, expected + 6, std::as_const(image).getBuffer()));
+            }
+        }
+    }
+
+    SECTION("16-bit samples keep their values") {
+        ImageFile file(testFile("format_p5.pgm"));
+        REQUIRE(file.isOpen());
+        std::vector<std::uint16_t> samples(file.getHeader().sampleCount());
+        REQUIRE(file.decode(samples.data()));
+        for (int i = 0; i < 6; ++i) REQUIRE(samples[i] == expected[i] * 257);
+    }
+
+    SECTION("Colour images and processors") {
+        PPMImage colour;
+        colour.read(testFile("format_p6.ppm"));
+        REQUIRE(colour.getWidth() == 3);
+        REQUIRE(colour.getBuffer()[4].g == 238);
+        PPMImage expanded;
+        expanded.read(testFile("format_p2.pgm"));
+        REQUIRE(expanded.getBuffer()[5].b == 255);
+
+        PPMProcessor fromColour(testFile("format_p3.ppm"));
+        PGMProcessor fromGray(testFile("format_p2.pgm"));
+        REQUIRE(fromColour.extractComponents(100, 1) == 1);
+        REQUIRE(fromGray.extractComponents(100, 1) == 1);
+        REQUIRE(fromColour.getLargestSize() == 3);
+    }
+
+    SECTION("Bad rasters leave the image empty") {
+        writeBytes(testFile("format_bad.pgm"), "P5\n3 2\n255\n" + std::string(5, 'x'));
+        writeBytes(testFile("format_range.pgm"), "P2\n3 2\n15\n0 1 2 3 4 16\n");
+        for (const std::string& name : {testFile("format_bad.pgm"), testFile("format_range.pgm")}) {
+            PGMimage image;
+            image.read(name);
+            REQUIRE(std::as_const(image).getBuffer() == nullptr);
+        }
+    }
+
+    SECTION("Huge dimensions with a short raster are refused before allocating") {
+        writeBytes(testFile("format_huge.pgm"), "P5\n16777216 16777216\n255\nxx");
+        writeBytes(testFile("format_huge16.pgm"), "P5\n1024 1024\n65535\n" + std::string(1024 * 1024, 'x'));
+        writeBytes(testFile("format_huge.ppm"), "P3\n16777216 16777216\n255\n1 2 3\n");
+        for (const std::string& name : {testFile("format_huge.pgm"), testFile("format_huge16.pgm"), testFile("format_huge.ppm")}) {
+            REQUIRE_FALSE(ImageFile(name).isOpen());
+            PGMimage image;
+            image.read(name);
+            REQUIRE(std::as_const(image).getBuffer() == nullptr);
+            PGMImage gray;
+            gray.read(name);
+            REQUIRE(gray.getWidth() == 0);
+            PPMImage colour;
+            colour.read(name);
+            REQUIRE(colour.getWidth() == 0);
+        }
+    }
+}
+
+// 16-bit and float images are thresholded and labelled in their own sample type
+TEST_CASE("Deep sample pipeline", "[deep]") {
+    SECTION("Kernels") {
+        std::mt19937 rng(11);
+        std::uniform_int_distribution<int> level(0, 65535);
+        const std::size_t count = GENERATE(0, 7, 16, 33, 64, 65, 200, 1031);
+        std::vector<std::uint16_t> words(count);
+        std::vector<float> floats(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            words[i] = static_cast<std::uint16_t>(level(rng));
+            floats[i] = (i % 17 == 5) ? std::nanf("") : words[i] / 7.0f;
+        }
+        for (int threshold : {0, 1, 32767, 32768, 65535}) {
+            const float floatThreshold = threshold / 7.0f;
+            std::vector<unsigned char> wordBytes(count, 17), floatBytes(count, 17);
+            std::vector<std::uint64_t> wordBits((count + 63) / 64, ~0ULL), floatBits((count + 63) / 64, ~0ULL);
+            thresholdToByteMask(words.data(), wordBytes.data(), count, static_cast<std::uint16_t>(threshold));
+            thresholdToBitMask(words.data(), wordBits.data(), count, static_cast<std::uint16_t>(threshold));
+            thresholdToByteMask(floats.data(), floatBytes.data(), count, floatThreshold);
+            thresholdToBitMask(floats.data(), floatBits.data(), count, floatThreshold);
+
+            INFO("kernel " << thresholdKernelName() << ", threshold " << threshold);
+            for (std::size_t i = 0; i < count; ++i) {
+                const bool word = words[i] >= threshold;
+                const bool real = floats[i] >= floatThreshold;
+                REQUIRE(wordBytes[i] == (word ? 255 : 0));
+                REQUIRE(((wordBits[i / 64] >> (i % 64)) & 1) == (word ? 1u : 0u));
+                REQUIRE(floatBytes[i] == (real ? 255 : 0));
+                REQUIRE(((floatBits[i / 64] >> (i % 64)) & 1) == (real ? 1u : 0u));
+            }
+            if (count % 64 != 0) {
+                REQUIRE((wordBits.back() >> (count % 64)) == 0);
+                REQUIRE((floatBits.back() >> (count % 64)) == 0);
+            }
+        }
+    }
+
+    // 12-bit levels that 8-bit conversion would merge: with maxval 4095, 4000 and 4010 both
+    // become 249, so only a full-depth threshold separates the two halves of the image
+    const int width = 41, height = 23;
+    std::mt19937 rng(23);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::string raster;
+    std::vector<std::uint16_t> levels;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            std::uint16_t value = 100;
+            if (percent(rng) < 60) value = (x < width / 2) ? 4000 : 4010;
+            levels.push_back(value);
+            raster += static_cast<char>(value >> 8);
+            raster += static_cast<char>(value & 0xFF);
+        }
+    }
+    writeBytes(testFile("deep_12bit.pgm"), "P5\n41 23\n4095\n" + raster);
+
+    SECTION("Full-depth thresholds") {
+        PGM16Image image;
+        image.read(testFile("deep_12bit.pgm"));
+        REQUIRE(image.getMaxValue() == 4095);
+        REQUIRE(std::equal(levels.begin(), levels.end(), image.getBuffer()));
+
+        int expectedPixels = 0;
+        for (std::uint16_t value : levels) expectedPixels += value >= 4005;
+        for (auto method : {LabelingMethod::BFS, LabelingMethod::TwoPass, LabelingMethod::MaxTree}) {
+            for (auto connectivity : {Connectivity::Four, Connectivity::Eight}) {
+                ExtractionOptions options;
+                options.method = method;
+                options.connectivity = connectivity;
+                PGM16Processor words(testFile("deep_12bit.pgm"));
+                FloatProcessor floats(testFile("deep_12bit.pgm"));
+                words.extractComponents(4005, 1, options);
+                floats.extractComponents(4005.0f, 1, options);
+
+                int pixels = 0;
+                REQUIRE(words.getComponentCount() == floats.getComponentCount());
+                for (std::size_t i = 0; i < words.getComponents().size(); ++i) {
+                    const auto& component = *words.getComponents()[i];
+                    pixels += component.getNumPixels();
+                    REQUIRE(component.getStats().minX >= width / 2);
+                    REQUIRE(sortedPixels(component) == sortedPixels(*floats.getComponents()[i]));
+                }
+                REQUIRE(pixels == expectedPixels);
+            }
+        }
+
+        // The 8-bit reader cannot tell the levels apart
+        PGMProcessor bytes(testFile("deep_12bit.pgm"));
+        bytes.extractComponents(249, 1);
+        int bytePixels = 0;
+        for (const auto& component : bytes.getComponents()) bytePixels += component->getNumPixels();
+        REQUIRE(bytePixels > expectedPixels);
+    }
+
+    SECTION("16-bit write round trip") {
+        PGM16Image image;
+        image.read(testFile("deep_12bit.pgm"));
+        image.write(testFile("deep_copy.pgm"));
+        PGM16Image copy;
+        copy.read(testFile("deep_copy.pgm"));
+        REQUIRE(copy.getMaxValue() == 4095);
+        REQUIRE(std::equal(levels.begin(), levels.end(), copy.getBuffer()));
+    }
+}
+
+// The integer colour kernel must reproduce the double luma for every RGB triple
+TEST_CASE("Colour conversion", "[colour]") {
+    SECTION("Exhaustive against grayFromRGB") {
+        const auto& sets = colourKernelSets();
+        REQUIRE(std::string(sets.front().name) == "scalar");
+        REQUIRE(std::string(sets.back().name) == colourKernelName());
+
+        // One row per (r, g) with every b; the rows are converted at odd offsets so the
+        // vector loops and scalar tails both see every value. Every supported variant is run
+        std::vector<unsigned char> rgb(3 * 259);
+        std::vector<unsigned char> gray(259);
+        for (const ColourKernelSet& set : sets) {
+            long long mismatches = 0;
+            for (int r = 0; r < 256; ++r) {
+                for (int g = 0; g < 256; ++g) {
+                    const int offset = (r + g) % 3;
+                    for (int b = 0; b < 256; ++b) {
+                        rgb[3 * (b + offset)] = r;
+                        rgb[3 * (b + offset) + 1] = g;
+                        rgb[3 * (b + offset) + 2] = b;
+                    }
+                    set.rgbToGray(rgb.data() + 3 * offset, gray.data(), 256);
+                    for (int b = 0; b < 256; ++b) mismatches += gray[b] != grayFromRGB(r, g, b);
+                }
+            }
+            INFO("kernel " << set.name);
+            REQUIRE(mismatches == 0);
+        }
+    }
+
+    SECTION("Colour processors and images") {
+        const int width = 37, height = 11;
+        std::mt19937 rng(29);
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::string raster;
+        std::vector<unsigned char> expected;
+        for (int i = 0; i < width * height; ++i) {
+            const int r = byte(rng), g = byte(rng), b = byte(rng);
+            raster += {static_cast<char>(r), static_cast<char>(g), static_cast<char>(b)};
+            expected.push_back(grayFromRGB(r, g, b));
+        }
+        writeBytes(testFile("colour_test.ppm"), "P6\n37 11\n255\n" + raster);
+
+        PPMImage colour;
+        colour.read(testFile("colour_test.ppm"));
+        PGMImage converted = colour.toGrayscale();
+        REQUIRE(std::equal(expected.begin(), expected.end(), converted.getBuffer()));
+        PGMimage direct;
+        direct.read(testFile("colour_test.ppm"));
+        REQUIRE(std::equal(expected.begin(), expected.end(), std::as_const(direct).getBuffer()));
+
+        PGMimage gray;
+        gray.setImageData(expected.data(), width, height);
+        gray.write(testFile("colour_gray.pgm"));
+        for (auto method : {LabelingMethod::BFS, LabelingMethod::TwoPass, LabelingMethod::MaxTree}) {
+            ExtractionOptions options;
+            options.method = method;
+            PPMProcessor fromColour(testFile("colour_test.ppm"));
+            PGMProcessor fromGray(testFile("colour_gray.pgm"));
+            REQUIRE(fromColour.extractComponents(128, 1, options) == fromGray.extractComponents(128, 1, options));
+            for (std::size_t i = 0; i < fromGray.getComponents().size(); ++i) {
+                REQUIRE(sortedPixels(*fromColour.getComponents()[i]) == sortedPixels(*fromGray.getComponents()[i]));
+            }
+        }
+    }
+}
+
+// The binary export reads back in place; CSV and JSON carry the same records
+TEST_CASE("Component export", "[export]") {
+    writeNoiseImage(testFile("noise_export.pgm"), 67, 45, 50, 123);
+    PGMimageProcessor processor(testFile("noise_export.pgm"));
+    processor.extractComponents(128, 2);
+    const auto& components = processor.getComponents();
+    REQUIRE(components.size() > 1);
+
+    REQUIRE(componentDataFormatFor("out.csv") == ComponentDataFormat::Csv);
+    REQUIRE(componentDataFormatFor("-") == ComponentDataFormat::Csv);
+    REQUIRE(componentDataFormatFor("out.JSON") == ComponentDataFormat::Json);
+    REQUIRE(componentDataFormatFor("out.fcc") == ComponentDataFormat::Binary);
+
+    REQUIRE(processor.writeComponentData(testFile("export_test.fcc"), ComponentDataFormat::Binary));
+    {
+        ComponentResults results(testFile("export_test.fcc"));
+        REQUIRE(results.isOpen());
+        REQUIRE(results.getCount() == components.size());
+        REQUIRE(results.getWidth() == 67);
+        REQUIRE(results.getHeight() == 45);
+        for (std::size_t k = 0; k < components.size(); ++k) {
+            const ComponentStats& stats = components[k]->getStats();
+            REQUIRE(results.ids()[k] == static_cast<std::uint32_t>(components[k]->getId()));
+            REQUIRE(results.classes()[k] == components[k]->getClassValue());
+            REQUIRE(results.sizes()[k] == static_cast<std::uint64_t>(stats.area));
+            REQUIRE(results.minX()[k] == stats.minX);
+            REQUIRE(results.minY()[k] == stats.minY);
+            REQUIRE(results.maxX()[k] == stats.maxX);
+            REQUIRE(results.maxY()[k] == stats.maxY);
+            REQUIRE(results.centroidX()[k] == stats.centroidX());
+            REQUIRE(results.centroidY()[k] == stats.centroidY());
+            const auto spans = results.spans(k);
+            const auto& runs = components[k]->getRuns();
+            REQUIRE(spans.size() == runs.size());
+            for (std::size_t r = 0; r < runs.size(); ++r) {
+                REQUIRE(spans[r].y == runs[r].y);
+                REQUIRE(spans[r].xStart == runs[r].xStart);
+                REQUIRE(spans[r].xEnd == runs[r].xEnd);
+            }
+        }
+        REQUIRE(results.spans(components.size()).empty());
+    }
+
+    // Truncated and foreign files are refused
+    {
+        std::ifstream in(testFile("export_test.fcc"), std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream(testFile("export_short.fcc"), std::ios::binary).write(bytes.data(), bytes.size() - 8);
+        REQUIRE_FALSE(ComponentResults(testFile("export_short.fcc")).isOpen());
+        REQUIRE_FALSE(ComponentResults(testFile("noise_export.pgm")).isOpen());
+
+        // A closed file has no sections to point into
+        ComponentResults closed(testFile("export_short.fcc"));
+        REQUIRE(closed.getCount() == 0);
+        REQUIRE(closed.ids() == nullptr);
+        REQUIRE(closed.sizes() == nullptr);
+        REQUIRE(closed.centroidY() == nullptr);
+        REQUIRE(closed.spans(0).empty());
+    }
+
+    // Results move with their buffer and cannot be copied
+    {
+        static_assert(!std::is_copy_constructible_v<ComponentResults> && !std::is_copy_assignable_v<ComponentResults>);
+        ComponentResults original(testFile("export_test.fcc"));
+        ComponentResults moved(std::move(original));
+        REQUIRE_FALSE(original.isOpen());
+        REQUIRE(original.ids() == nullptr);
+        REQUIRE(moved.getCount() == components.size());
+        ComponentResults assigned(testFile("export_short.fcc"));
+        assigned = std::move(moved);
+        REQUIRE_FALSE(moved.isOpen());
+        REQUIRE(assigned.sizes()[0] == static_cast<std::uint64_t>(components[0]->getStats().area));
+        REQUIRE(assigned.spans(0).size() == components[0]->getRuns().size());
+    }
+
+    REQUIRE(processor.writeComponentData(testFile("export_test.csv"), ComponentDataFormat::Csv));
+    {
+        std::ifstream csv(testFile("export_test.csv"));
+        std::string line;
+        std::getline(csv, line);
+        REQUIRE(line == "id,class,size,min_x,min_y,max_x,max_y,centroid_x,centroid_y");
+        for (const auto& component : components) {
+            REQUIRE(std::getline(csv, line));
+            std::istringstream fields(line);
+            std::string field;
+            std::vector<std::string> values;
+            while (std::getline(fields, field, ',')) values.push_back(field);
+            REQUIRE(values.size() == 9);
+            REQUIRE(std::stoi(values[0]) == component->getId());
+            REQUIRE(std::stoll(values[2]) == component->getStats().area);
+            REQUIRE(std::stoi(values[5]) == component->getStats().maxX);
+            REQUIRE(std::stod(values[7]) == component->getStats().centroidX());   // shortest exact form
+        }
+        REQUIRE_FALSE(std::getline(csv, line));
+    }
+
+    REQUIRE(processor.writeComponentData(testFile("export_test.json"), ComponentDataFormat::Json));
+    {
+        std::ifstream json(testFile("export_test.json"));
+        std::string text((std::istreambuf_iterator<char>(json)), std::istreambuf_iterator<char>());
+        REQUIRE(text.rfind("{\"width\": 67, \"height\": 45, \"components\": [", 0) == 0);
+        REQUIRE(std::count(text.begin(), text.end(), '{') == static_cast<long>(components.size()) + 1);
+        const ComponentStats& first = components[0]->getStats();
+        std::ostringstream record;
+        record << "{\"id\": " << components[0]->getId() << ", \"class\": 0, \"size\": " << first.area
+               << ", \"box\": [" << first.minX << ", " << first.minY << ", " << first.maxX << ", " << first.maxY << "]";
+        REQUIRE(text.find(record.str()) != std::string::npos);
+        REQUIRE(text.substr(text.size() - 3) == "]}\n");
+    }
+}
+
+// Label maps number the kept components densely in list order
+TEST_CASE("Label map output", "[labels]") {
+    writeNoiseImage(testFile("noise_labels.pgm"), 71, 43, 45, 99);
+    PGMimageProcessor processor(testFile("noise_labels.pgm"));
+    processor.extractComponents(128, 1);
+    REQUIRE(processor.filterComponentsBySize(2, 1000) > 1);
+    const auto& components = processor.getComponents();
+
+    std::vector<std::uint32_t> expected(71 * 43, 0);
+    for (std::size_t k = 0; k < components.size(); ++k) {
+        for (auto [x, y] : components[k]->getPixels()) expected[y * 71 + x] = static_cast<std::uint32_t>(k + 1);
+    }
+
+    REQUIRE(labelMapFormatFor("labels.pgm") == LabelMapFormat::Pgm16);
+    REQUIRE(labelMapFormatFor("labels.PGM") == LabelMapFormat::Pgm16);
+    REQUIRE(labelMapFormatFor("labels.lbl") == LabelMapFormat::Raw32);
+
+    REQUIRE(processor.writeLabelMap(testFile("labels_test.lbl"), LabelMapFormat::Raw32));
+    std::vector<std::uint32_t> labels;
+    int width = 0, height = 0;
+    std::uint32_t count = 0;
+    REQUIRE(readLabelMap(testFile("labels_test.lbl"), labels, width, height, count));
+    REQUIRE(width == 71);
+    REQUIRE(height == 43);
+    REQUIRE(count == components.size());
+    REQUIRE(labels == expected);
+
+    REQUIRE(processor.writeLabelMap(testFile("labels_test.pgm"), LabelMapFormat::Pgm16));
+    PGM16Image pgm;
+    pgm.read(testFile("labels_test.pgm"));
+    REQUIRE(pgm.getMaxValue() == 65535);
+    REQUIRE(std::vector<std::uint32_t>(pgm.getBuffer(), pgm.getBuffer() + 71 * 43) == expected);
+
+    // A foreign file is not taken for a label map
+    REQUIRE_FALSE(readLabelMap(testFile("labels_test.pgm"), labels, width, height, count));
+
+    // A header claiming 2^24 x 2^24 labels over a 20-byte file is refused without allocating
+    {
+        std::ifstream in(testFile("labels_test.lbl"), std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string huge = bytes.substr(0, 20);
+        huge.replace(8, 8, std::string("\0\0\0\1\0\0\0\1", 8));   // little-endian 2^24, twice
+        writeBytes(testFile("labels_huge.lbl"), huge);
+        REQUIRE_FALSE(readLabelMap(testFile("labels_huge.lbl"), labels, width, height, count));
+        writeBytes(testFile("labels_short.lbl"), bytes.substr(0, bytes.size() - 1));
+        REQUIRE_FALSE(readLabelMap(testFile("labels_short.lbl"), labels, width, height, count));
+    }
+
+    SECTION("Too many components for 16 bits") {
+        const int side = 400;   // a checkerboard has side * side / 2 single-pixel components
+        std::vector<unsigned char> board(side * side);
+        for (int i = 0; i < side * side; ++i) board[i] = ((i % side + i / side) % 2) ? 255 : 0;
+        PGMimage image;
+        image.setImageData(board.data(), side, side);
+        image.write(testFile("labels_board.pgm"));
+        PGMimageProcessor boardProcessor(testFile("labels_board.pgm"));
+        REQUIRE(boardProcessor.extractComponents(128, 1) == side * side / 2);
+        REQUIRE_FALSE(boardProcessor.writeLabelMap(testFile("labels_board_out.pgm"), LabelMapFormat::Pgm16));
+        REQUIRE(boardProcessor.writeLabelMap(testFile("labels_board_out.lbl"), LabelMapFormat::Raw32));
+        REQUIRE(readLabelMap(testFile("labels_board_out.lbl"), labels, width, height, count));
+        REQUIRE(count == side * side / 2);
+        REQUIRE(*std::max_element(labels.begin(), labels.end()) == count);
+    }
+}
+
+// Reads back a binary PPM written by the overlay
+static std::vector<unsigned char> readPPMBytes(const std::string& fileName, int& width, int& height) {
+    ImageFile file(fileName);
+    width = file.getHeader().width;
+    height = file.getHeader().height;
+    std::vector<unsigned char> rgb(file.isOpen() ? file.getHeader().sampleCount() : 0);
+    if (file.isOpen()) file.decode(rgb.data());
+    return rgb;
+}
+
+// The streamed overlay matches drawing every box into a full copy of the image
+TEST_CASE("Streaming box overlay", "[overlay]") {
+    SECTION("Edges across row blocks") {
+        // Wide rows give blocks of two rows, so boxes straddle block boundaries
+        const int width = 50000, height = 21;
+        auto background = [&](int x, int y) { return static_cast<unsigned char>((x * 7 + y * 13) & 0xFF); };
+        std::vector<unsigned char> expected(static_cast<size_t>(width) * height * 3);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                for (int c = 0; c < 3; ++c) expected[(static_cast<size_t>(y) * width + x) * 3 + c] = background(x, y) + c;
+            }
+        }
+        OverlayWriter overlay(width, height, RGBPixel(1, 2, 3));
+        auto draw = [&](int minX, int minY, int maxX, int maxY) {
+            for (int y = std::max(minY, 0); y <= std::min(maxY, height - 1); ++y) {
+                for (int x = std::max(minX, 0); x <= std::min(maxX, width - 1); ++x) {
+                    const bool edge = x == std::max(minX, 0) || x == std::min(maxX, width - 1) ||
+                                      y == std::max(minY, 0) || y == std::min(maxY, height - 1);
+                    if (!edge) continue;
+                    unsigned char* px = &expected[(static_cast<size_t>(y) * width + x) * 3];
+                    px[0] = 1; px[1] = 2; px[2] = 3;
+                }
+            }
+        };
+        std::mt19937 rng(41);
+        std::uniform_int_distribution<int> xs(-5, width + 5), ys(-2, height + 2);
+        for (int i = 0; i < 200; ++i) {
+            int x0 = xs(rng), x1 = xs(rng), y0 = ys(rng), y1 = ys(rng);
+            if (x0 > x1) std::swap(x0, x1);
+            if (y0 > y1) std::swap(y0, y1);
+            overlay.addBox(x0, y0, x1, y1);
+            if (x1 >= 0 && y1 >= 0 && x0 < width && y0 < height) draw(x0, y0, x1, y1);
+        }
+        overlay.addBox(3, 3, 3, 3);   // a single pixel
+        draw(3, 3, 3, 3);
+        overlay.addBox(width, 0, width + 4, 4);   // entirely outside
+        overlay.addBox(9, 5, 8, 6);               // empty
+
+        REQUIRE(overlay.write(testFile("overlay_test.ppm"), [&](int y, unsigned char* rgb) {
+            for (int x = 0; x < width; ++x) {
+                for (int c = 0; c < 3; ++c) rgb[3 * x + c] = background(x, y) + c;
+            }
+        }));
+        int readWidth = 0, readHeight = 0;
+        const auto written = readPPMBytes(testFile("overlay_test.ppm"), readWidth, readHeight);
+        REQUIRE(readWidth == width);
+        REQUIRE(readHeight == height);
+        REQUIRE(written == expected);
+    }
+
+    SECTION("Processor output") {
+        writeNoiseImage(testFile("noise_overlay.pgm"), 83, 59, 40, 77);
+        PGMProcessor gray(testFile("noise_overlay.pgm"));
+        gray.extractComponents(128, 3);
+        REQUIRE(gray.getComponentCount() > 0);
+        REQUIRE(gray.writeComponentsWithBoxes(testFile("overlay_gray.ppm")));
+
+        PGMImage source;
+        source.read(testFile("noise_overlay.pgm"));
+        const int width = source.getWidth(), height = source.getHeight();
+        std::vector<unsigned char> expected;
+        for (int i = 0; i < width * height; ++i) expected.insert(expected.end(), 3, source.getBuffer()[i]);
+        for (const auto& comp : gray.getComponents()) {
+            const ComponentStats& box = comp->getStats();
+            for (int y = box.minY; y <= box.maxY; ++y) {
+                for (int x = box.minX; x <= box.maxX; ++x) {
+                    if (x != box.minX && x != box.maxX && y != box.minY && y != box.maxY) continue;
+                    unsigned char* px = &expected[(static_cast<size_t>(y) * width + x) * 3];
+                    px[0] = 255; px[1] = 0; px[2] = 0;
+                }
+            }
+        }
+        int readWidth = 0, readHeight = 0;
+        REQUIRE(readPPMBytes(testFile("overlay_gray.ppm"), readWidth, readHeight) == expected);
+
+        // Colour input keeps its pixels under the same boxes
+        PPMImage colourSource;
+        colourSource.read(testFile("noise_overlay.pgm"));
+        colourSource.write(testFile("overlay_colour_in.ppm"));
+        PPMProcessor colour(testFile("overlay_colour_in.ppm"));
+        colour.extractComponents(128, 3);
+        REQUIRE(colour.writeComponentsWithBoxes(testFile("overlay_colour.ppm")));
+        REQUIRE(readPPMBytes(testFile("overlay_colour.ppm"), readWidth, readHeight) == expected);
+    }
+}
+
+// One multi-class pass finds the same components as one binary pass per class
+TEST_CASE("Multi-class labeling", "[classes]") {
+    const int width = 53, height = 47;
+    const RGBPixel palette[4] = {RGBPixel(0, 0, 0), RGBPixel(255, 0, 0), RGBPixel(0, 255, 0), RGBPixel(255, 0, 1)};
+    std::mt19937 rng(31);
+    std::uniform_int_distribution<int> pick(0, 3);
+    std::vector<RGBPixel> pixels(width * height);
+    for (auto& pixel : pixels) pixel = palette[pick(rng)];
+    PPMImage image;
+    image.setImageData(pixels.data(), width, height);
+    image.write(testFile("classes_test.ppm"));
+
+    for (auto connectivity : {Connectivity::Four, Connectivity::Eight}) {
+        // Reference: a binary labeling of each colour's mask
+        std::vector<std::tuple<std::uint32_t, std::vector<std::pair<int, int>>, long long>> expected;
+        for (const RGBPixel& colour : palette) {
+            const std::uint32_t value = PPMProcessor::classOf(colour);
+            std::vector<unsigned char> mask(width * height);
+            for (int i = 0; i < width * height; ++i) mask[i] = PPMProcessor::classOf(pixels[i]) == value ? 255 : 0;
+            auto binary = withConnectivity(connectivity, [&](auto policy) {
+                return labelTwoPass<decltype(policy)>(mask.data(), width, height, 128, 1);
+            });
+            for (const auto& component : binary) {
+                expected.emplace_back(value, sortedPixels(*component), component->getStats().perimeter());
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+
+        for (int threads : {1, 3}) {
+            PPMProcessor processor(testFile("classes_test.ppm"));
+            ExtractionOptions options;
+            options.connectivity = connectivity;
+            options.numThreads = threads;
+            processor.extractClassComponents(1, std::nullopt, options);
+            std::vector<std::tuple<std::uint32_t, std::vector<std::pair<int, int>>, long long>> found;
+            for (const auto& component : processor.getComponents()) {
+                found.emplace_back(component->getClassValue(), sortedPixels(*component), component->getStats().perimeter());
+            }
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == expected);
+
+            // Ignoring the background drops exactly its components
+            const std::uint32_t background = PPMProcessor::classOf(palette[0]);
+            PPMProcessor foreground(testFile("classes_test.ppm"));
+            foreground.extractClassComponents(1, background, options);
+            const auto kept = std::count_if(expected.begin(), expected.end(),
+                                            [&](const auto& entry) { return std::get<0>(entry) != background; });
+            REQUIRE(foreground.getComponentCount() == kept);
+            REQUIRE(foreground.filterComponents(ComponentFilter().ofClass(0xFF0001)) ==
+                    std::count_if(expected.begin(), expected.end(),
+                                  [](const auto& entry) { return std::get<0>(entry) == 0xFF0001u; }));
+        }
+    }
+
+    SECTION("Gray levels as classes") {
+        // Two touching blocks of different levels stay apart; equal levels apart in space too
+        const unsigned char gray[] = {
+            5, 5, 9, 9, 0,
+            5, 5, 9, 0, 5,
+            0, 0, 0, 0, 5};
+        PGMimage pgm;
+        pgm.setImageData(const_cast<unsigned char*>(gray), 5, 3);
+        pgm.write(testFile("classes_gray.pgm"));
+        PGMProcessor processor(testFile("classes_gray.pgm"));
+        REQUIRE(processor.extractClassComponents(1, 0u) == 3);
+        const auto& components = processor.getComponents();
+        REQUIRE(components[0]->getClassValue() == 5);
+        REQUIRE(components[0]->getNumPixels() == 4);
+        REQUIRE(components[1]->getClassValue() == 9);
+        REQUIRE(components[1]->getNumPixels() == 3);
+        REQUIRE(components[2]->getClassValue() == 5);
+        REQUIRE(components[2]->getStats().minX == 4);
+    }
+}
+
+// The streaming extractor must find the same components as the in-memory labeler
+TEST_CASE("Streaming extraction matches in-memory extraction", "[streaming]") {
+    const int bandRows = GENERATE(1, 7, 64);
+    const Connectivity connectivity = GENERATE(Connectivity::Four, Connectivity::Eight);
+    writeNoiseImage(testFile("noise_stream.pgm"), 71, 90, 55, 4242);
+
+    std::vector<ComponentStats> streamed;
+    StreamingExtractor extractor(testFile("noise_stream.pgm"), bandRows, connectivity);
+    int count = extractor.extract(100, 2, [&](int id, const ComponentStats& stats) {
+        REQUIRE(id == static_cast<int>(streamed.size()));
+        streamed.push_back(stats);
+    });
+
+    PGMimageProcessor processor(testFile("noise_stream.pgm"));
+    ExtractionOptions options;
+    options.connectivity = connectivity;
+    REQUIRE(count == processor.extractComponents(100, 2, options));
+    REQUIRE(count == static_cast<int>(streamed.size()));
+
+    // Completion order differs from raster order, so match components by their summaries
+    auto key = [](const ComponentStats& s) {
+        return std::make_tuple(s.minY, s.minX, s.area, s.maxX, s.maxY, s.sumX, s.sumY, s.internalEdges);
+    };
+    std::vector<decltype(key(streamed[0]))> expected, actual;
+    for (const auto& stats : streamed) actual.push_back(key(stats));
+    for (const auto& component : processor.getComponents()) expected.push_back(key(component->getStats()));
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    REQUIRE(actual == expected);
+
+    SECTION("Centroid of a known block") {
+        ComponentStats block;
+        block.addRun(2, 1, 4);
+        block.addRun(3, 1, 4);
+        REQUIRE(block.area == 8);
+        REQUIRE(block.centroidX() == Approx(2.5));
+        REQUIRE(block.centroidY() == Approx(2.5));
+    }
+
+    SECTION("Other maxvals are scaled as in-memory reads scale them") {
+        // A 16-bit P5 and an 8-bit P5 with maxval 15, each with random levels
+        std::mt19937 rng(99);
+        for (int maxval : {1000, 15}) {
+            std::string raster;
+            for (int i = 0; i < 71 * 90; ++i) {
+                int v = static_cast<int>(rng() % (maxval + 1));
+                if (maxval > 255) raster += static_cast<char>(v >> 8);
+                raster += static_cast<char>(v & 0xFF);
+            }
+            const std::string name = testFile("noise_stream_deep.pgm");
+            std::ofstream(name, std::ios::binary) << "P5\n# levels\n71 90\n" << maxval << "\n" << raster;
+
+            std::vector<decltype(key(streamed[0]))> deepStreamed, deepExpected;
+            StreamingExtractor deep(name, bandRows, connectivity);
+            int deepCount = deep.extract(100, 2, [&](int, const ComponentStats& stats) { deepStreamed.push_back(key(stats)); });
+            PGMimageProcessor reference(name);
+            REQUIRE(deepCount == reference.extractComponents(100, 2, options));
+            for (const auto& component : reference.getComponents()) deepExpected.push_back(key(component->getStats()));
+            std::sort(deepStreamed.begin(), deepStreamed.end());
+            std::sort(deepExpected.begin(), deepExpected.end());
+            REQUIRE(deepStreamed == deepExpected);
+        }
+
+        // Formats other than P5 cannot be streamed
+        std::ofstream(testFile("noise_stream_ascii.pgm")) << "P2\n2 1\n255\n0 255\n";
+        StreamingExtractor ascii(testFile("noise_stream_ascii.pgm"), bandRows);
+        REQUIRE(ascii.extract(100, 1, [](int, const ComponentStats&) {}) == -1);
+    }
+
+    SECTION("A truncated raster is an error") {
+        std::ifstream in(testFile("noise_stream.pgm"), std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream(testFile("noise_stream_short.pgm"), std::ios::binary).write(bytes.data(), bytes.size() - 71 * 20 - 5);
+        StreamingExtractor truncated(testFile("noise_stream_short.pgm"), bandRows);
+        REQUIRE(truncated.extract(100, 2, [](int, const ComponentStats&) {}) == -1);
+
+        PGMrowReader reader(testFile("noise_stream_short.pgm"));
+        std::vector<unsigned char> rows(71 * 90);
+        REQUIRE(reader.readRows(rows.data(), 60) == 60);
+        REQUIRE(reader.readRows(rows.data(), 30) == -1);
+        REQUIRE(reader.readRows(rows.data(), 30) == 0);
+    }
+}
+
+// Shape statistics accumulated during labeling must agree with a direct computation
+TEST_CASE("Incremental component statistics", "[stats]") {
+    SECTION("Known shapes") {
+        ComponentStats bar;              // 6 x 2 horizontal bar
+        bar.addRun(4, 2, 7);
+        bar.addRun(5, 2, 7);
+        bar.addInternalEdges(6);
+        REQUIRE(bar.boxWidth() == 6);
+        REQUIRE(bar.boxHeight() == 2);
+        REQUIRE(bar.perimeter() == 16);
+        REQUIRE(bar.orientation() == Approx(0.0).margin(1e-12));
+        REQUIRE(bar.compactness() == Approx(4 * std::numbers::pi * 12 / 256));
+
+        ComponentStats diagonal;         // staircase of single pixels along y = x
+        for (int i = 0; i < 5; ++i) diagonal.addRun(i, i, i);
+        REQUIRE(diagonal.perimeter() == 20);
+        REQUIRE(diagonal.orientation() == Approx(std::numbers::pi / 4));
+    }
+
+    SECTION("Both engines agree with a recount from the pixels") {
+        const int density = GENERATE(20, 55, 85);
+        writeNoiseImage(testFile("noise_shape.pgm"), 53, 61, density, 99 + density);
+
+        for (auto method : {LabelingMethod::BFS, LabelingMethod::TwoPass}) {
+            PGMimageProcessor processor(testFile("noise_shape.pgm"));
+            ExtractionOptions options;
+            options.method = method;
+            options.numThreads = 3;
+            processor.extractComponents(128, 1, options);
+
+            for (const auto& component : processor.getComponents()) {
+                std::set<std::pair<int, int>> pixels(component->pixels().begin(), component->pixels().end());
+                long long edges = 0;
+                double sumXY = 0;
+                int minX = 53, maxX = -1, minY = 61;
+                for (auto [x, y] : pixels) {
+                    edges += pixels.count({x + 1, y}) + pixels.count({x, y + 1});
+                    sumXY += static_cast<double>(x) * y;
+                    minX = std::min(minX, x);
+                    maxX = std::max(maxX, x);
+                    minY = std::min(minY, y);
+                }
+                const ComponentStats& stats = component->getStats();
+                REQUIRE(stats.area == component->getNumPixels());
+                REQUIRE(stats.perimeter() == 4 * stats.area - 2 * edges);
+                REQUIRE(stats.sumXY == Approx(sumXY));
+                REQUIRE(stats.minX == minX);
+                REQUIRE(stats.maxX == maxX);
+                REQUIRE(stats.minY == minY);
+            }
+        }
+    }
+}
+
+// One-pass filtering, predicate chains and the size index
+TEST_CASE("Component filtering", "[filter]") {
+    std::vector<std::unique_ptr<ConnectedComponent>> components;
+    auto add = [&](int id, int y, int xStart, int xEnd, int rows) {
+        components.push_back(std::make_unique<ConnectedComponent>(id));
+        for (int r = 0; r < rows; ++r) components.back()->addRun(y + r, xStart, xEnd);
+    };
+    add(0, 0, 0, 9, 1);     // 10 x 1 line
+    add(1, 2, 0, 3, 4);     // 4 x 4 square
+    add(2, 10, 5, 5, 6);    // 1 x 6 column
+    add(3, 20, 20, 21, 2);  // 2 x 2 square
+
+    SECTION("Predicates chain and keep order") {
+        ComponentFilter filter;
+        filter.size(4, 16).aspectRatio(0.5, 2.0);
+        REQUIRE(filter.apply(components) == 2);
+        REQUIRE(components.size() == 2);
+        REQUIRE(components[0]->getId() == 1);
+        REQUIRE(components[1]->getId() == 3);
+
+        REQUIRE(ComponentFilter().within(0, 0, 10, 10).apply(components) == 1);
+        REQUIRE(components[0]->getId() == 1);
+        REQUIRE(ComponentFilter().apply(components) == 0);
+    }
+
+    SECTION("Box size and custom predicates") {
+        ComponentFilter filter;
+        filter.boxSize(1, 2, 10, 10).where([](const ConnectedComponent& c) { return c.getId() != 3; });
+        REQUIRE(filter.apply(components) == 2);
+        REQUIRE(components.size() == 2);
+        REQUIRE(components[0]->getId() == 1);
+        REQUIRE(components[1]->getId() == 2);
+    }
+
+    SECTION("Size index answers range queries") {
+        ComponentSizeIndex index;
+        index.build(components);
+        REQUIRE(index.largest() == 16);
+        REQUIRE(index.smallest() == 4);
+        REQUIRE(index.countInRange(5, 10) == 2);
+        REQUIRE(index.countInRange(16, 100) == 1);
+        REQUIRE(index.countInRange(11, 15) == 0);
+        REQUIRE(index.countInRange(10, 5) == 0);
+    }
+
+    SECTION("Processor keeps the index in step with filtering") {
+        writeNoiseImage(testFile("noise_filter.pgm"), 300, 200, 50, 77);
+        PGMimageProcessor processor(testFile("noise_filter.pgm"));
+        processor.extractComponents(128, 1);
+        std::vector<int> sizes;
+        for (const auto& component : processor.getComponents()) sizes.push_back(component->getNumPixels());
+        int expected = std::count_if(sizes.begin(), sizes.end(), [](int size) { return size >= 3 && size <= 20; });
+
+        REQUIRE(processor.getLargestSize() == *std::max_element(sizes.begin(), sizes.end()));
+        REQUIRE(processor.countComponentsInRange(3, 20) == expected);
+        REQUIRE(processor.filterComponentsBySize(3, 20) == expected);
+        REQUIRE(processor.getSmallestSize() >= 3);
+        REQUIRE(processor.getLargestSize() <= 20);
+        REQUIRE(processor.filterComponentsBySize(3, 20) == expected);
+        REQUIRE(processor.filterComponents(ComponentFilter().size(5, 5)) ==
+                std::count(sizes.begin(), sizes.end(), 5));
+        REQUIRE(processor.getLargestSize() == 5);
+    }
+}
+
+// Thresholding while labelling must give the same components as labelling a finished mask
+TEST_CASE("Fused threshold and label", "[fused]") {
+    const int threads = GENERATE(1, 3);
+    const int width = GENERATE(1, 63, 64, 130);
+    std::mt19937 rng(width * 7 + threads);
+    std::uniform_int_distribution<int> value(0, 255);
+    const int height = 57;
+    std::vector<unsigned char> gray(static_cast<size_t>(width) * height);
+    for (auto& pixel : gray) pixel = static_cast<unsigned char>(value(rng));
+
+    BitImage mask(width, height);
+    mask.threshold(gray.data(), 120);
+    auto expected = labelTwoPass(mask, 2, false, threads);
+    auto actual = labelTwoPass(gray.data(), width, height, 120, 2, false, threads);
+
+    REQUIRE(actual.size() == expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        REQUIRE(actual[i]->getId() == expected[i]->getId());
+        REQUIRE(actual[i]->getNumPixels() == expected[i]->getNumPixels());
+        REQUIRE(actual[i]->getStats().perimeter() == expected[i]->getStats().perimeter());
+        REQUIRE(sortedPixels(*actual[i]) == sortedPixels(*expected[i]));
+    }
+}
+
+// One max-tree must reproduce a separate extraction at every threshold
+TEST_CASE("Threshold sweep", "[sweep]") {
+    const int minValid = GENERATE(1, 4);
+    writeNoiseImage(testFile("noise_sweep.pgm"), 41, 37, 60, 2024);
+    {
+        // Spread the values over the whole range so many thresholds differ
+        PGMimage image;
+        image.read(testFile("noise_sweep.pgm"));
+        unsigned char* data = image.getBuffer();
+        std::mt19937 rng(5);
+        std::uniform_int_distribution<int> value(0, 255);
+        for (int i = 0; i < 41 * 37; ++i) data[i] = static_cast<unsigned char>(value(rng));
+        image.write(testFile("noise_sweep.pgm"));
+    }
+
+    PGMimageProcessor sweeper(testFile("noise_sweep.pgm"));
+    auto sweep = sweeper.sweepThresholds(minValid);
+    REQUIRE(sweep.size() == 256);
+
+    for (int t = 0; t < 256; t += 5) {
+        PGMimageProcessor processor(testFile("noise_sweep.pgm"));
+        int count = processor.extractComponents(static_cast<unsigned char>(t), minValid);
+        const ThresholdSummary& summary = sweep[t];
+        REQUIRE(summary.threshold == t);
+        REQUIRE(summary.count == count);
+        REQUIRE(summary.largest == processor.getLargestSize());
+        REQUIRE(summary.smallest == processor.getSmallestSize());
+        std::array<int, 32> histogram{};
+        for (const auto& component : processor.getComponents()) {
+            histogram[std::bit_width(static_cast<unsigned>(component->getNumPixels())) - 1]++;
+        }
+        REQUIRE(summary.histogram == histogram);
+    }
+
+    SECTION("Selected thresholds") {
+        auto selected = sweeper.sweepThresholds(minValid, {200, 0, 300});
+        REQUIRE(selected.size() == 3);
+        REQUIRE(selected[0].threshold == 200);
+        REQUIRE(selected[0].count == sweep[200].count);
+        REQUIRE(selected[1].count == 1);      // everything is foreground at 0
+        REQUIRE(selected[1].largest == 41 * 37);
+        REQUIRE(selected[2].threshold == 255);
+    }
+
+    SECTION("Constant image is one node") {
+        std::vector<unsigned char> flat(20 * 10, 90);
+        MaxTree tree(flat.data(), 20, 10);
+        REQUIRE(tree.nodeCount() == 1);
+        auto summaries = tree.sweep(1);
+        REQUIRE(summaries[90].count == 1);
+        REQUIRE(summaries[91].count == 0);
+        REQUIRE(summaries[91].largest == 0);
+    }
+}
+
+// Components enumerated from the max-tree index must match labeling at every threshold
+TEST_CASE("Max-tree component index", "[maxtree]") {
+    const int width = 47, height = 39;
+    std::vector<unsigned char> gray(width * height);
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> noise(0, 60);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            // Smooth ramps plus noise give nested components over many levels
+            int value = (x * 5 + y * 3) % 200 + noise(rng);
+            gray[y * width + x] = static_cast<unsigned char>(std::min(value, 255));
+        }
+    }
+    MaxTree tree(gray.data(), width, height);
+    REQUIRE(tree.nodeCount() > 1);
+
+    for (int t = 0; t < 256; t += 17) {
+        for (int minValid : {1, 5}) {
+            for (bool countDiscarded : {false, true}) {
+                BitImage mask(width, height);
+                mask.threshold(gray.data(), static_cast<unsigned char>(t));
+                auto expected = labelTwoPass(mask, minValid, countDiscarded);
+                auto actual = tree.componentsAt(static_cast<unsigned char>(t), minValid, countDiscarded);
+                REQUIRE(actual.size() == expected.size());
+                for (size_t i = 0; i < actual.size(); ++i) {
+                    REQUIRE(actual[i]->getId() == expected[i]->getId());
+                    REQUIRE(actual[i]->getNumPixels() == expected[i]->getNumPixels());
+                    REQUIRE(actual[i]->getStats().perimeter() == expected[i]->getStats().perimeter());
+                    REQUIRE(sortedPixels(*actual[i]) == sortedPixels(*expected[i]));
+                }
+            }
+        }
+    }
+
+    SECTION("Processor keeps the tree after releasing the image") {
+        PGMimage image;
+        image.setImageData(gray.data(), width, height);
+        image.write(testFile("maxtree_test.pgm"));
+
+        PGMimageProcessor processor(testFile("maxtree_test.pgm"));
+        ExtractionOptions options;
+        options.method = LabelingMethod::MaxTree;
+        for (int t : {150, 40, 220}) {
+            PGMimageProcessor reference(testFile("maxtree_test.pgm"));
+            REQUIRE(processor.extractComponents(static_cast<unsigned char>(t), 3, options) ==
+                    reference.extractComponents(static_cast<unsigned char>(t), 3));
+            REQUIRE(processor.getComponentCount() == reference.getComponentCount());
+            REQUIRE(processor.getLargestSize() == reference.getLargestSize());
+        }
+        REQUIRE(processor.sweepThresholds(3, {40})[0].count == processor.sweepThresholds(3)[40].count);
+
+        // The other methods need the released image and find nothing rather than reading it
+        for (auto method : {LabelingMethod::TwoPass, LabelingMethod::BFS}) {
+            options.method = method;
+            REQUIRE(processor.extractComponents(150, 3, options) == 0);
+            REQUIRE(processor.getComponentCount() == 0);
+        }
+    }
+}
+
+// Neighbourhood policies and 8-connected labeling across all engines
+TEST_CASE("Connectivity policies", "[connectivity]") {
+    SECTION("Policy helpers") {
+        using Cross = MaskConnectivity<0xAA>;          // same neighbours as FourConnectivity
+        using Backslash = MaskConnectivity<0xAA | 0x1 | 0x100>;   // plus (-1,-1) and (1,1)
+        static_assert(Cross::offsets.size() == 4);
+        static_assert(MaskConnectivity<0x1EF>::offsets.size() == 8);
+        static_assert(rowReach<FourConnectivity>() == std::make_pair(0, 0));
+        static_assert(rowReach<EightConnectivity>() == std::make_pair(-1, 1));
+        static_assert(rowReach<Backslash>() == std::make_pair(-1, 0));
+        static_assert(runsTouch<EightConnectivity>(5, 6, 7, 9));
+        static_assert(!runsTouch<FourConnectivity>(5, 6, 7, 9));
+        static_assert(runsTouch<Backslash>(5, 6, 2, 4));      // (4, y-1) is up-left of (5, y)
+        static_assert(!runsTouch<Backslash>(5, 6, 7, 9));     // up-right is not a neighbour
+        int visited = 0;
+        forEachOffset<Backslash>([&](Offset o) { visited += (o.dx == o.dy && o.dx != 0); });
+        REQUIRE(visited == 2);
+    }
+
+    SECTION("Diagonal staircase") {
+        // Pixels (i, i) only touch at corners
+        std::vector<unsigned char> gray(10 * 10, 0);
+        for (int i = 0; i < 10; ++i) gray[i * 10 + i] = 255;
+        REQUIRE(labelTwoPass<FourConnectivity>(gray.data(), 10, 10, 128, 1).size() == 10);
+        auto eight = labelTwoPass<EightConnectivity>(gray.data(), 10, 10, 128, 1);
+        REQUIRE(eight.size() == 1);
+        REQUIRE(eight[0]->getNumPixels() == 10);
+        REQUIRE(eight[0]->getStats().perimeter() == 40);   // no edge is shared
+        REQUIRE(MaxTree(gray.data(), 10, 10, Connectivity::Eight).componentsAt(128, 1).size() == 1);
+    }
+
+    SECTION("Custom mask matches a flood fill") {
+        using Backslash = MaskConnectivity<0xAA | 0x1 | 0x100>;
+        const int width = 41, height = 37;
+        const int density = GENERATE(40, 60);
+        std::mt19937 rng(5 + density);
+        std::vector<unsigned char> gray(width * height);
+        for (auto& g : gray) g = (static_cast<int>(rng() % 100) < density) ? 255 : 0;
+
+        // Reference: flood fill from each unvisited foreground pixel in raster order
+        std::vector<std::vector<std::pair<int, int>>> reference;
+        std::vector<bool> seen(gray.size(), false);
+        for (int start = 0; start < width * height; ++start) {
+            if (gray[start] < 128 || seen[start]) continue;
+            std::vector<std::pair<int, int>> pixels;
+            std::vector<int> stack{start};
+            seen[start] = true;
+            while (!stack.empty()) {
+                int p = stack.back();
+                stack.pop_back();
+                pixels.push_back({p % width, p / width});
+                for (const Offset& o : Backslash::offsets) {
+                    int x = p % width + o.dx, y = p / width + o.dy;
+                    if (x < 0 || x >= width || y < 0 || y >= height) continue;
+                    int q = y * width + x;
+                    if (gray[q] >= 128 && !seen[q]) {
+                        seen[q] = true;
+                        stack.push_back(q);
+                    }
+                }
+            }
+            std::sort(pixels.begin(), pixels.end());
+            reference.push_back(pixels);
+        }
+
+        BitImage mask(width, height);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x) mask.set(x, y, gray[y * width + x] >= 128);
+        for (int threads : {1, 3}) {
+            for (const auto& components : {labelTwoPass<Backslash>(gray.data(), width, height, 128, 1, false, threads),
+                                           labelTwoPass<Backslash>(mask, 1, false, threads)}) {
+                std::vector<std::vector<std::pair<int, int>>> found;
+                for (const auto& component : components) found.push_back(sortedPixels(*component));
+                REQUIRE(found == reference);
+            }
+        }
+    }
+
+    SECTION("Engines agree under 8-connectivity") {
+        const int density = GENERATE(30, 50, 70);
+        writeNoiseImage(testFile("noise_eight.pgm"), 67, 73, density, 17 + density);
+
+        std::vector<std::vector<std::pair<int, int>>> reference;
+        long long referencePerimeter = -1;
+        for (auto method : {LabelingMethod::BFS, LabelingMethod::TwoPass, LabelingMethod::MaxTree}) {
+            for (int threads : {1, 3}) {
+                PGMimageProcessor processor(testFile("noise_eight.pgm"));
+                ExtractionOptions options;
+                options.method = method;
+                options.numThreads = threads;
+                options.connectivity = Connectivity::Eight;
+                processor.extractComponents(128, 2, options);
+
+                std::vector<std::vector<std::pair<int, int>>> found;
+                long long perimeter = 0;
+                for (const auto& component : processor.getComponents()) {
+                    REQUIRE(component->getId() == static_cast<int>(found.size()));
+                    found.push_back(sortedPixels(*component));
+                    perimeter += component->getStats().perimeter();
+                }
+                if (reference.empty()) {
+                    reference = found;
+                    referencePerimeter = perimeter;
+                }
+                REQUIRE(found == reference);
+                REQUIRE(perimeter == referencePerimeter);
+            }
+        }
+    }
+}
+
+// The BFS mask keeps a background frame so flood fills reach the image edges without bounds tests
+TEST_CASE("Padded BFS mask", "[bfs]") {
+    SECTION("Layout") {
+        std::vector<unsigned char> gray(5 * 3, 200);
+        PaddedMask mask(5, 3);
+        mask.threshold(gray.data(), 128);
+        REQUIRE(mask.getStride() == 7);
+        REQUIRE(mask.index(0, 0) == 8);
+        REQUIRE(mask.xOf(mask.index(4, 2)) == 4);
+        REQUIRE(mask.yOf(mask.index(4, 2)) == 2);
+        for (int y = 0; y < 3; ++y) {
+            REQUIRE(mask.row(y)[-1] == PaddedMask::Background);
+            REQUIRE(mask.row(y)[5] == PaddedMask::Background);
+            for (int x = 0; x < 5; ++x) REQUIRE(mask.row(y)[x] == PaddedMask::Foreground);
+        }
+        for (int x = -1; x <= 5; ++x) {
+            REQUIRE(mask[mask.index(x, -1)] == PaddedMask::Background);
+            REQUIRE(mask[mask.index(x, 3)] == PaddedMask::Background);
+        }
+    }
+
+    SECTION("Components on the image edges") {
+        // Dense noise puts components on every edge and corner, and a one-pixel-wide image
+        // has its only column against both sides of the frame
+        auto [width, height] = GENERATE(std::make_pair(31, 29), std::make_pair(1, 40), std::make_pair(40, 1));
+        writeNoiseImage(testFile("noise_border.pgm"), width, height, 75, 5 + width);
+        for (auto connectivity : {Connectivity::Four, Connectivity::Eight}) {
+            std::vector<std::vector<std::vector<std::pair<int, int>>>> results;
+            std::vector<long long> perimeters;
+            for (auto method : {LabelingMethod::BFS, LabelingMethod::TwoPass}) {
+                PGMimageProcessor processor(testFile("noise_border.pgm"));
+                ExtractionOptions options;
+                options.method = method;
+                options.connectivity = connectivity;
+                processor.extractComponents(128, 1, options);
+                std::vector<std::vector<std::pair<int, int>>> found;
+                long long perimeter = 0;
+                for (const auto& component : processor.getComponents()) {
+                    found.push_back(sortedPixels(*component));
+                    perimeter += component->getStats().perimeter();
+                }
+                results.push_back(found);
+                perimeters.push_back(perimeter);
+            }
+            REQUIRE(!results[0].empty());
+            REQUIRE(results[0] == results[1]);
+            REQUIRE(perimeters[0] == perimeters[1]);
+        }
+    }
+}
+
+// Memory resource that counts what passes through it
+class CountingResource : public std::pmr::memory_resource {
+    public:
+        long long allocations = 0;
+        long long bytesLive = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            allocations++;
+            bytesLive += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+            bytesLive -= bytes;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Components and their runs come from the arena and are released with it
+TEST_CASE("Component arena", "[arena]") {
+    writeNoiseImage(testFile("noise_arena.pgm"), 120, 80, 45, 31);
+
+    SECTION("Labeler allocates components and runs from the given resource") {
+        PGMimage image;
+        image.read(testFile("noise_arena.pgm"));
+        BitImage mask(120, 80);
+        mask.threshold(std::as_const(image).getBuffer(), 128);
+
+        CountingResource counting;
+        {
+            auto components = labelTwoPass(mask, 1, false, 2, nullptr, &counting);
+            REQUIRE(!components.empty());
+            // One block for each component object and one for its exactly reserved runs
+            REQUIRE(counting.allocations == 2 * static_cast<long long>(components.size()));
+            REQUIRE(components[0]->getRuns().get_allocator().resource() == &counting);
+        }
+        REQUIRE(counting.bytesLive == 0);
+    }
+
+    SECTION("Processor copies, moves and resets") {
+        PGMimageProcessor original(testFile("noise_arena.pgm"));
+        int count = original.extractComponents(128, 2);
+        REQUIRE(count > 0);
+        int largest = original.getLargestSize();
+
+        PGMimageProcessor copy = original;
+        PGMimageProcessor moved = std::move(original);
+        REQUIRE(moved.getComponentCount() == count);
+        REQUIRE(moved.getLargestSize() == largest);
+
+        moved.reset();
+        REQUIRE(moved.getComponentCount() == 0);
+        REQUIRE(moved.getLargestSize() == 0);
+
+        // The copy owns its own arena and is unaffected
+        REQUIRE(copy.getComponentCount() == count);
+        REQUIRE(copy.getLargestSize() == largest);
+        long long pixels = 0;
+        for (const auto& component : copy.getComponents()) pixels += component->getStats().area;
+        REQUIRE(pixels >= 2LL * count);
+    }
+
+    SECTION("Move assignment between processors that both hold components") {
+        writeNoiseImage(testFile("noise_arena_small.pgm"), 40, 30, 60, 32);
+        PGMimageProcessor source(testFile("noise_arena.pgm"));
+        PGMimageProcessor target(testFile("noise_arena_small.pgm"));
+        const int count = source.extractComponents(128, 2);
+        REQUIRE(target.extractComponents(128, 1) > 0);
+        target = std::move(source);
+        REQUIRE(target.getComponentCount() == count);
+        long long targetPixels = 0;
+        for (const auto& component : target.getComponents()) targetPixels += component->getStats().area;
+        REQUIRE(targetPixels >= 2LL * count);
+
+        PGMProcessor generic(testFile("noise_arena.pgm"));
+        PGMProcessor other(testFile("noise_arena_small.pgm"));
+        REQUIRE(generic.extractComponents(128, 2) == count);
+        REQUIRE(other.extractComponents(128, 1) > 0);
+        other = std::move(generic);
+        REQUIRE(other.getComponentCount() == count);
+        long long pixels = 0;
+        for (const auto& component : other.getComponents()) pixels += component->getStats().area;
+        REQUIRE(pixels >= 2LL * count);
+        other.reset();
+        REQUIRE(other.extractComponents(128, 2) == count);
+    }
+}
+
+// Batch inputs, the shared pool and per-image results
+TEST_CASE("Batch processing", "[batch]") {
+    namespace fs = std::filesystem;
+    fs::remove_all(testFile("batch_test"));
+    fs::create_directories(testFile("batch_test/out"));
+    for (int i = 0; i < 3; ++i) {
+        writeNoiseImage(testFile("batch_test/img") + std::to_string(i) + ".pgm", 40, 30, 40 + 10 * i, 500 + i);
+    }
+    std::ofstream(testFile("batch_test/notes.txt")) << "not an image\n";
+    std::ofstream(testFile("batch_test/list.lst"))
+        << "# manifest\n" << testFile("batch_test/img2.pgm") << "\n\n" << testFile("batch_test/img0.pgm") << "\n";
+
+    SECTION("Thread pool runs every task") {
+        std::atomic<int> done{0};
+        ThreadPool pool(3);
+        for (int i = 0; i < 50; ++i) pool.submit([&] { done++; });
+        pool.wait();
+        REQUIRE(done == 50);
+    }
+
+    SECTION("Directories, patterns and manifests expand to inputs") {
+        REQUIRE(collectBatchInputs(testFile("batch_test")).size() == 3);
+        REQUIRE(collectBatchInputs(testFile("batch_test/img[12]*")).empty());
+        REQUIRE(collectBatchInputs(testFile("batch_test/img?.pgm")).size() == 3);
+        auto listed = collectBatchInputs(testFile("batch_test/list.lst"));
+        REQUIRE(listed == std::vector<std::string>{testFile("batch_test/img2.pgm"), testFile("batch_test/img0.pgm")});
+
+        // Colour inputs are images too, whether found in a directory or named directly
+        fs::create_directories(testFile("batch_test/colour"));
+        writeBytes(testFile("batch_test/colour/a.ppm"), "P6\n1 1\n255\n" + std::string(3, '\xff'));
+        writeBytes(testFile("batch_test/colour/b.pnm"), "P3\n1 1\n255\n255 255 255\n");
+        std::ofstream(testFile("batch_test/colour/c.txt")) << "not an image\n";
+        REQUIRE(collectBatchInputs(testFile("batch_test/colour")) ==
+                std::vector<std::string>{testFile("batch_test/colour/a.ppm"), testFile("batch_test/colour/b.pnm")});
+        REQUIRE(collectBatchInputs(testFile("batch_test/colour/a.ppm")) ==
+                std::vector<std::string>{testFile("batch_test/colour/a.ppm")});
+        BatchOptions options;
+        auto results = runBatch(collectBatchInputs(testFile("batch_test/colour")), options);
+        REQUIRE(results.size() == 2);
+        REQUIRE((results[0].ok && results[0].count == 1 && results[1].ok && results[1].count == 1));
+    }
+
+    SECTION("Batch results match single-image runs") {
+        auto inputs = collectBatchInputs(testFile("batch_test"));
+        inputs.push_back(testFile("batch_test/missing.pgm"));
+        BatchOptions options;
+        options.threshold = 100;
+        options.minValidSize = 2;
+        options.numThreads = 2;
+        options.memoryBudget = 1000; // smaller than one image, so images go one at a time
+        options.outputDir = testFile("batch_test/out");
+        auto results = runBatch(inputs, options);
+
+        REQUIRE(results.size() == 4);
+        for (int i = 0; i < 3; ++i) {
+            PGMimageProcessor single(inputs[i]);
+            REQUIRE(results[i].ok);
+            REQUIRE(results[i].count == single.extractComponents(100, 2));
+            REQUIRE(results[i].largest == single.getLargestSize());
+            REQUIRE(fs::exists(testFile("batch_test/out/img") + std::to_string(i) + "_components.pgm"));
+        }
+        REQUIRE_FALSE(results[3].ok);
+        REQUIRE(writeBatchSummary(testFile("batch_test/out/summary.csv"), results));
+    }
+}
+
+// Processors fill in their timings and counters when instrumentation is compiled in
+TEST_CASE("Processing statistics", "[stats]") {
+    writeNoiseImage(testFile("noise_stats.pgm"), 50, 40, 50, 77);
+    PGMimageProcessor twoPass(testFile("noise_stats.pgm"));
+    PGMimageProcessor bfs(testFile("noise_stats.pgm"));
+    ExtractionOptions bfsOptions;
+    bfsOptions.method = LabelingMethod::BFS;
+    int count = twoPass.extractComponents(100, 3);
+    bfs.extractComponents(100, 3, bfsOptions);
+    twoPass.filterComponentsBySize(3, 1000);
+
+    const ProcessingStats& stats = twoPass.getStats();
+    if constexpr (ProcessingStats::enabled) {
+        REQUIRE(stats.getCalls(Phase::Read) == 1);
+        REQUIRE(stats.getCalls(Phase::Threshold) == 0);   // fused into labeling
+        REQUIRE(stats.getCalls(Phase::Label) == 1);
+        REQUIRE(stats.getCalls(Phase::Filter) == 1);
+        REQUIRE(stats.get(Counter::Pixels) == 50 * 40);
+        REQUIRE(stats.get(Counter::Runs) > 0);
+        REQUIRE(stats.get(Counter::Allocations) == count);
+        REQUIRE(stats.get(Counter::Components) >= count);
+        REQUIRE(bfs.getStats().get(Counter::Components) == stats.get(Counter::Components));
+        REQUIRE(bfs.getStats().get(Counter::QueuePushes) > 0);
+        REQUIRE(bfs.getStats().get(Counter::QueuePushes) <= bfs.getStats().get(Counter::Pixels));
+
+        // Both processors account for building and querying the max-tree the same way
+        ExtractionOptions treeOptions;
+        treeOptions.method = LabelingMethod::MaxTree;
+        PGMimageProcessor legacy(testFile("noise_stats.pgm"));
+        PGMProcessor generic(testFile("noise_stats.pgm"));
+        legacy.extractComponents(100, 3, treeOptions);
+        generic.extractComponents(100, 3, treeOptions);
+        for (Phase phase : {Phase::Threshold, Phase::Label}) {
+            REQUIRE(generic.getStats().getCalls(phase) == legacy.getStats().getCalls(phase));
+        }
+        for (Counter counter : {Counter::Pixels, Counter::Components, Counter::Allocations}) {
+            REQUIRE(generic.getStats().get(counter) == legacy.getStats().get(counter));
+        }
+    } else {
+        REQUIRE(stats.getCalls(Phase::Label) == 0);
+        REQUIRE(stats.get(Counter::Pixels) == 0);
+    }
+
+    std::ostringstream json;
+    stats.writeJson(json);
+    REQUIRE(json.str().find("\"counters\"") != std::string::npos);
 }
\ No newline at end of file